@@ -0,0 +1,133 @@
+#include "arena.h"
+
+#include <new>
+
+std::byte* Arena::Slab::Slot(size_t index) noexcept {
+    return reinterpret_cast<std::byte*>(this) + kSlabHeaderSize + index * slot_size;
+}
+
+size_t Arena::Slab::IndexOf(void* slot) noexcept {
+    return (static_cast<std::byte*>(slot) - Slot(0)) / slot_size;
+}
+
+Arena::~Arena() {
+    for (SizeClass& size_class : size_classes_) {
+        while (Slab* slab = size_class.slabs) {
+            size_class.slabs = slab->next;
+            slab->~Slab();
+            ::operator delete(slab, std::align_val_t{kSlabSize});
+        }
+    }
+}
+
+void* Arena::Allocate(size_t size) {
+    if (size > kMaxSlotSize) {
+        throw std::bad_alloc{};
+    }
+    SizeClass& size_class = size_classes_[SizeClassIndex(size)];
+    if (!size_class.free_list) {
+        return BumpAllocate(&size_class, size);
+    }
+    void* slot = size_class.free_list;
+    size_class.free_list = size_class.free_list->next;
+    Slab* slab = SlabOf(slot);
+    slab->used.set(slab->IndexOf(slot));
+    ++slab->used_count;
+    return slot;
+}
+
+void* Arena::AllocateFresh(size_t size) {
+    if (size > kMaxSlotSize) {
+        throw std::bad_alloc{};
+    }
+    return BumpAllocate(&size_classes_[SizeClassIndex(size)], size);
+}
+
+void* Arena::BumpAllocate(SizeClass* size_class, size_t size) {
+    Slab* slab = size_class->bump_slab;
+    if (!slab || slab->bump == slab->slots_count) {
+        slab = NewSlab(SizeClassIndex(size) * kGranularity);
+        slab->next = size_class->slabs;
+        size_class->slabs = slab;
+        size_class->bump_slab = slab;
+    }
+    size_t index = slab->bump++;
+    slab->used.set(index);
+    ++slab->used_count;
+    return slab->Slot(index);
+}
+
+void Arena::Free(void* slot) noexcept {
+    Slab* slab = SlabOf(slot);
+    slab->used.reset(slab->IndexOf(slot));
+    --slab->used_count;
+    SizeClass& size_class = size_classes_[slab->slot_size / kGranularity];
+    size_class.free_list = new (slot) FreeSlot{size_class.free_list};
+}
+
+void Arena::BeginSweep() noexcept {
+    for (SizeClass& size_class : size_classes_) {
+        size_class.sweep_slab = size_class.slabs;
+    }
+    sweep_class_ = 0;
+}
+
+size_t Arena::BeginParallelSweep() {
+    sweep_chunks_.clear();
+    for (SizeClass& size_class : size_classes_) {
+        for (Slab* slab = size_class.slabs; slab; slab = slab->next) {
+            sweep_chunks_.push_back(slab);
+        }
+    }
+    return sweep_chunks_.size();
+}
+
+void Arena::ReleaseInSweep(void* slot) noexcept {
+    Slab* slab = SlabOf(slot);
+    slab->used.reset(slab->IndexOf(slot));
+    --slab->used_count;
+}
+
+void Arena::ReleaseEmptySlabs() {
+    sweep_chunks_.clear();
+    for (SizeClass& size_class : size_classes_) {
+        size_class.free_list = nullptr;
+        Slab** link = &size_class.slabs;
+        while (Slab* slab = *link) {
+            if (slab->used_count) {
+                // Slots are prepended from the newest slab, so the oldest one is reused first
+                for (size_t i = slab->bump; i-- > 0;) {
+                    if (!slab->used[i]) {
+                        size_class.free_list = new (slab->Slot(i)) FreeSlot{size_class.free_list};
+                    }
+                }
+                link = &slab->next;
+                continue;
+            }
+            if (slab == size_class.bump_slab) {
+                size_class.bump_slab = nullptr;
+            }
+            *link = slab->next;
+            slab->~Slab();
+            ::operator delete(slab, std::align_val_t{kSlabSize});
+        }
+    }
+}
+
+size_t Arena::GetSlabsCount() const noexcept {
+    size_t count = 0;
+    for (const SizeClass& size_class : size_classes_) {
+        for (Slab* slab = size_class.slabs; slab; slab = slab->next) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+Arena::Slab* Arena::NewSlab(size_t slot_size) {
+    void* memory = ::operator new(kSlabSize, std::align_val_t{kSlabSize});
+    Slab* slab = new (memory) Slab{};
+    slab->slot_size = slot_size;
+    slab->slots_count = (kSlabSize - kSlabHeaderSize) / slot_size;
+    return slab;
+}
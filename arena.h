@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Allocator of small objects. Each size class has its own slabs of equal slots, slots are
+// taken from the free list of the class or bump allocated from the newest slab.
+// Slabs are aligned to their size, so the slab of a slot is found by masking its address.
+class Arena {
+public:
+    static constexpr size_t kSlabSize = 1 << 16;
+    static constexpr size_t kGranularity = 8;
+    static constexpr size_t kMinSlotSize = 16;
+    static constexpr size_t kMaxSlotSize = 256;
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct Slab {
+        // Slabs of a size class are linked from the newest to the oldest one, so the arena
+        // doesn't allocate anything besides the slabs
+        Slab* next;
+        size_t slot_size;
+        size_t slots_count;
+        size_t used_count = 0;
+        // Slots from bump to the end have never been allocated
+        size_t bump = 0;
+        std::bitset<kSlabSize / kMinSlotSize> used;
+
+        std::byte* Slot(size_t index) noexcept;
+
+        size_t IndexOf(void* slot) noexcept;
+    };
+
+    struct SizeClass {
+        Slab* slabs = nullptr;
+        FreeSlot* free_list = nullptr;
+        Slab* bump_slab = nullptr;
+        // Next slab to be swept, slabs before it were created after BeginSweep
+        Slab* sweep_slab = nullptr;
+    };
+
+    static constexpr size_t kSlabHeaderSize = (sizeof(Slab) + 15) / 16 * 16;
+
+    std::array<SizeClass, kMaxSlotSize / kGranularity + 1> size_classes_;
+    size_t sweep_class_ = size_classes_.size();
+    std::vector<Slab*> sweep_chunks_;
+
+public:
+    Arena() = default;
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena();
+
+    void* Allocate(size_t size);
+
+    // Bump allocation which skips the free list, so slots allocated one after another are
+    // adjacent unless a new slab is started
+    void* AllocateFresh(size_t size);
+
+    void Free(void* slot) noexcept;
+
+    // Calls visit for every allocated slot, visit may free the slot
+    template <class Visitor>
+    void ForEachSlot(Visitor&& visit) {
+        for (SizeClass& size_class : size_classes_) {
+            for (Slab* slab = size_class.slabs; slab; slab = slab->next) {
+                for (size_t i = 0; i < slab->bump; ++i) {
+                    if (slab->used[i]) {
+                        visit(static_cast<void*>(slab->Slot(i)));
+                    }
+                }
+            }
+        }
+    }
+
+    // Lazy sweeping visits the slabs which exist now, a slab at a time. Slabs created later
+    // aren't visited. Empty slabs stay until ReleaseEmptySlabs.
+    void BeginSweep() noexcept;
+
+    // Calls visit for every allocated slot of the next slabs to be swept, until budget slots
+    // are visited. visit may free the slot. Returns true when all slabs are swept.
+    template <class Visitor>
+    bool SweepSlabs(size_t budget, Visitor&& visit) {
+        size_t visited_count = 0;
+        for (; sweep_class_ < size_classes_.size(); ++sweep_class_) {
+            SizeClass& size_class = size_classes_[sweep_class_];
+            while (Slab* slab = size_class.sweep_slab) {
+                if (visited_count >= budget) {
+                    return false;
+                }
+                for (size_t i = 0; i < slab->bump; ++i) {
+                    if (slab->used[i]) {
+                        visit(static_cast<void*>(slab->Slot(i)));
+                    }
+                }
+                visited_count += slab->bump;
+                size_class.sweep_slab = slab->next;
+            }
+        }
+        return true;
+    }
+
+    // Parallel sweeping numbers the slabs, each of them is a chunk swept by one thread.
+    // Returns the number of chunks.
+    size_t BeginParallelSweep();
+
+    // Calls visit for every allocated slot of the chunk. Threads may sweep different chunks
+    // at the same time, visit releases slots by ReleaseInSweep only.
+    template <class Visitor>
+    void SweepChunk(size_t index, Visitor&& visit) {
+        Slab* slab = sweep_chunks_[index];
+        for (size_t i = 0; i < slab->bump; ++i) {
+            if (slab->used[i]) {
+                visit(static_cast<void*>(slab->Slot(i)));
+            }
+        }
+    }
+
+    // Free which touches only the slab of the slot. The slot isn't reused until
+    // ReleaseEmptySlabs rebuilds the free lists.
+    static void ReleaseInSweep(void* slot) noexcept;
+
+    // Returns slabs without allocated slots to the system and rebuilds the free lists.
+    // Must not be called during a lazy sweep.
+    void ReleaseEmptySlabs();
+
+    size_t GetSlabsCount() const noexcept;
+
+private:
+    static size_t SizeClassIndex(size_t size) noexcept {
+        return (std::max(size, kMinSlotSize) + kGranularity - 1) / kGranularity;
+    }
+
+    static Slab* SlabOf(void* slot) noexcept {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(slot) & ~(kSlabSize - 1));
+    }
+
+    Slab* NewSlab(size_t slot_size);
+
+    void* BumpAllocate(SizeClass* size_class, size_t size);
+};
@@ -0,0 +1,92 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <scheme.h>
+
+namespace {
+
+// fib(n) makes fib(n + 1) * 2 - 1 calls
+constexpr int64_t kFibCalls[] = {1, 1, 3, 5, 9, 15, 25, 41, 67, 109, 177, 287, 465, 753,
+                                 1219, 1973, 3193, 5167, 8361, 13529, 21891};
+
+void RunFib(benchmark::State& state, EvalMode eval_mode) {
+    const std::string expression = "(fib " + std::to_string(state.range(0)) + ")";
+    Interpreter interpreter{eval_mode};
+    interpreter.Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(interpreter.Run(expression));
+    }
+    state.counters["calls_per_second"] =
+        benchmark::Counter(static_cast<double>(kFibCalls[state.range(0)] * state.iterations()),
+                           benchmark::Counter::kIsRate);
+}
+
+void BM_EvalFibBytecode(benchmark::State& state) {
+    RunFib(state, EvalMode::BYTECODE);
+}
+
+void BM_EvalFibTreeWalk(benchmark::State& state) {
+    RunFib(state, EvalMode::TREE_WALK);
+}
+
+// Walks a list of range(0) elements, mostly null?, car and cdr of cells
+void RunListWalk(benchmark::State& state, EvalMode eval_mode) {
+    Interpreter interpreter{eval_mode};
+    interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+    interpreter.Run("(define (sum l acc) (if (null? l) acc (sum (cdr l) (+ acc (car l)))))");
+    interpreter.Run("(define table (range " + std::to_string(state.range(0)) + " '()))");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(interpreter.Run("(sum table 0)"));
+    }
+    state.counters["elements_per_second"] = benchmark::Counter(
+        static_cast<double>(state.range(0) * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_EvalListWalkBytecode(benchmark::State& state) {
+    RunListWalk(state, EvalMode::BYTECODE);
+}
+
+void BM_EvalListWalkTreeWalk(benchmark::State& state) {
+    RunListWalk(state, EvalMode::TREE_WALK);
+}
+
+// Type checks alone over a mix of the objects the evaluator sees
+void BM_IsCell(benchmark::State& state) {
+    Heap heap;
+    std::vector<Object*> objects;
+    for (int i = 0; i < 1024; ++i) {
+        switch (i % 4) {
+            case 0:
+                objects.push_back(heap.Make<Cell>(nullptr, nullptr));
+                break;
+            case 1:
+                objects.push_back(Intern("x"));
+                break;
+            case 2:
+                objects.push_back(heap.Make<Number>(kFixnumMax + 1));
+                break;
+            default:
+                objects.push_back(heap.Make<Add>(&heap));
+        }
+    }
+    for (auto _ : state) {
+        size_t cells = 0;
+        for (Object* object : objects) {
+            cells += Is<Cell>(object) + Is<Procedure>(object);
+        }
+        benchmark::DoNotOptimize(cells);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(2 * objects.size() * state.iterations()));
+}
+
+}  // namespace
+
+BENCHMARK(BM_EvalFibBytecode)->Arg(20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EvalFibTreeWalk)->Arg(20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EvalListWalkBytecode)->Arg(10'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EvalListWalkTreeWalk)->Arg(10'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IsCell);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <object.h>
+
+namespace {
+
+// Full collection of a heap holding one list of range(0) cells
+void BM_MarkLongList(benchmark::State& state) {
+    Heap heap;
+    Scope scope{&heap};
+    Object* list = nullptr;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        list = heap.Make<Cell>(heap.Make<Number>(i), list);
+    }
+    scope.Define(Intern("list")->GetId(), list);
+    Object* roots[] = {&scope};
+    heap.Collect(roots, true);
+
+    for (auto _ : state) {
+        heap.Collect(roots, true);
+    }
+    state.counters["objects_per_second"] = benchmark::Counter(
+        static_cast<double>(heap.GetOldCount() * state.iterations()), benchmark::Counter::kIsRate);
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect(roots, true);
+}
+
+// Full collection of a balanced tree of range(0) cells and as many garbage cells with range(1)
+// collector threads. speedup is relative to the run with one thread of the same heap.
+void BM_ParallelCollect(benchmark::State& state) {
+    static std::map<int64_t, double> single_thread_times;
+    Heap heap;
+    heap.SetCollectorThreads(state.range(1));
+    Scope scope{&heap};
+    std::vector<Object*> level;
+    for (int64_t i = 0; i < state.range(0) / 2; ++i) {
+        level.push_back(heap.Make<Cell>(heap.Make<Number>(i), nullptr));
+    }
+    while (level.size() > 1) {
+        std::vector<Object*> next_level;
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            next_level.push_back(heap.Make<Cell>(level[i], level[i + 1]));
+        }
+        if (level.size() % 2) {
+            next_level.push_back(level.back());
+        }
+        level.swap(next_level);
+    }
+    scope.Define(Intern("tree")->GetId(), level.front());
+    Object* roots[] = {&scope};
+    heap.Collect(roots, true);
+    const size_t live_count = heap.Size();
+
+    double total_time = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < live_count; ++i) {
+            heap.Make<Cell>(nullptr, nullptr);
+        }
+        auto start = std::chrono::steady_clock::now();
+        heap.Collect(roots, true);
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(time.count());
+        total_time += time.count();
+    }
+    const double average_time = total_time / static_cast<double>(state.iterations());
+    if (state.range(1) == 1) {
+        single_thread_times[state.range(0)] = average_time;
+    }
+    if (single_thread_times.contains(state.range(0))) {
+        state.counters["speedup"] = single_thread_times[state.range(0)] / average_time;
+    }
+    state.counters["objects_per_second"] = benchmark::Counter(
+        static_cast<double>(2 * live_count * state.iterations()), benchmark::Counter::kIsRate);
+
+    scope.Define(Intern("tree")->GetId(), nullptr);
+    heap.Collect(roots, true);
+}
+
+// Walk of a list of range(0) cells linked in a random order, like a list built from reused
+// slots, range(1) compacts the heap before
+void BM_TraverseList(benchmark::State& state) {
+    Heap heap;
+    Scope scope{&heap};
+    std::vector<Cell*> cells;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        cells.push_back(heap.Make<Cell>(MakeNumber(&heap, i), nullptr));
+    }
+    std::shuffle(cells.begin(), cells.end(), std::mt19937{42});
+    for (size_t i = 0; i + 1 < cells.size(); ++i) {
+        cells[i]->SetTail(cells[i + 1]);
+    }
+    scope.Define(Intern("list")->GetId(), cells.front());
+    cells.clear();
+    if (state.range(1)) {
+        std::vector<Object**> root_slots;
+        scope.TraceSlots(&root_slots);
+        heap.CompactCells(root_slots);
+    }
+    Object* list = *scope.Lookup(Intern("list")->GetId());
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(GetVectorFromCell(list, &scope, false));
+    }
+    state.counters["cells_per_second"] = benchmark::Counter(
+        static_cast<double>(state.range(0) * state.iterations()), benchmark::Counter::kIsRate);
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect({}, true);
+}
+
+}  // namespace
+
+BENCHMARK(BM_MarkLongList)
+    ->RangeMultiplier(10)
+    ->Range(100'000, 10'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_ParallelCollect)
+    ->ArgsProduct({{1'000'000, 10'000'000}, {1, 2, 4, 8, 16}})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_TraverseList)
+    ->ArgsProduct({{1'000'000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <parser.h>
+#include <scheme.h>
+
+// Regression suite of the whole interpreter: tokenizer, parser, Run and the collector.
+// The bench_interpreter_json target runs it and writes bench_interpreter.json to compare builds.
+// Benchmarks of Run take the EvalMode as their last argument.
+
+namespace {
+
+constexpr int64_t kBytecode = static_cast<int64_t>(EvalMode::BYTECODE);
+constexpr int64_t kTreeWalk = static_cast<int64_t>(EvalMode::TREE_WALK);
+
+constexpr int64_t kIncremental = 0;
+constexpr int64_t kStopTheWorld = 1;
+constexpr int64_t kConcurrent = 2;
+
+// Generated script of range(0) definitions, like the large tables we load
+std::string MakeScript(int64_t definitions_count) {
+    std::string script = "(";
+    for (int64_t i = 0; i < definitions_count; ++i) {
+        script += "(define (entry-" + std::to_string(i) + " x)\n    (if (< x " +
+                  std::to_string(i) + ")\n        '(1 2 . -3)\n        (list x #t #f)))\n";
+    }
+    script += ")";
+    return script;
+}
+
+void BM_Tokenize(benchmark::State& state) {
+    const std::string script = MakeScript(state.range(0));
+    for (auto _ : state) {
+        Tokenizer tokenizer{std::string_view{script}};
+        size_t count = 0;
+        for (; !tokenizer.IsEnd(); tokenizer.Next()) {
+            ++count;
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(script.size() * state.iterations()));
+}
+
+// Read into the syntax arena, as Run does for the bytecode
+void BM_ReadToArena(benchmark::State& state) {
+    const std::string script = MakeScript(state.range(0));
+    SyntaxArena arena;
+    for (auto _ : state) {
+        Tokenizer tokenizer{std::string_view{script}};
+        benchmark::DoNotOptimize(Read(&tokenizer, &arena));
+        arena.Reset();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(script.size() * state.iterations()));
+}
+
+// Read onto the heap, as Run does for the tree walker, the syntax is collected between runs
+void BM_ReadToHeap(benchmark::State& state) {
+    const std::string script = MakeScript(state.range(0));
+    Heap heap;
+    for (auto _ : state) {
+        Tokenizer tokenizer{std::string_view{script}};
+        benchmark::DoNotOptimize(Read(&tokenizer, &heap));
+        state.PauseTiming();
+        heap.Collect({}, true);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(script.size() * state.iterations()));
+}
+
+// Each Run of the expression is one item
+void RunExpression(benchmark::State& state, EvalMode eval_mode, const std::string& setup,
+                   const std::string& expression) {
+    Interpreter interpreter{eval_mode};
+    if (!setup.empty()) {
+        interpreter.Run(setup);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(interpreter.Run(expression));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RunArithmetic(benchmark::State& state) {
+    RunExpression(state, static_cast<EvalMode>(state.range(0)), "",
+                  "(+ (* 3 4) (- 10 (abs -2)) (/ 81 9) (max 1 7 3) (min 4 2))");
+}
+
+// List of range(0) elements built by cons in a loop
+void BM_RunListBuilding(benchmark::State& state) {
+    RunExpression(state, static_cast<EvalMode>(state.range(1)),
+                  "(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))",
+                  "(range " + std::to_string(state.range(0)) + " '())");
+    state.counters["cells_per_second"] = benchmark::Counter(
+        static_cast<double>(state.range(0) * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+// range(0) calls of a small lambda from a counting loop
+void BM_RunLambdaCalls(benchmark::State& state) {
+    RunExpression(state, static_cast<EvalMode>(state.range(1)),
+                  "(define (loop n acc) (if (= n 0) acc (loop (- n 1) ((lambda (x) (+ x 1)) "
+                  "acc))))",
+                  "(loop " + std::to_string(state.range(0)) + " 0)");
+    state.counters["calls_per_second"] = benchmark::Counter(
+        static_cast<double>(state.range(0) * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+// Non tail recursion of depth range(0) and fib
+void BM_RunRecursion(benchmark::State& state) {
+    RunExpression(state, static_cast<EvalMode>(state.range(1)),
+                  "(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))",
+                  "(depth " + std::to_string(state.range(0)) + ")");
+}
+
+void BM_RunFib(benchmark::State& state) {
+    RunExpression(state, static_cast<EvalMode>(state.range(1)),
+                  "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+                  "(fib " + std::to_string(state.range(0)) + ")");
+}
+
+// Heap of range(0) live old cells in one list, range(1) selects a full or a minor collection.
+// Minor collections shouldn't depend on the size of the old generation.
+void BM_Collect(benchmark::State& state) {
+    Heap heap;
+    Scope scope{&heap};
+    Object* list = nullptr;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        list = heap.Make<Cell>(heap.Make<Number>(i), list);
+    }
+    scope.Define(Intern("list")->GetId(), list);
+    heap.Remember(&scope);
+    Object* roots[] = {&scope};
+    heap.Collect(roots, true);
+    heap.Collect(roots, true);
+
+    const bool full = state.range(1);
+    for (auto _ : state) {
+        heap.Collect(roots, full);
+    }
+    state.counters["heap_size"] = static_cast<double>(heap.Size());
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect(roots, true);
+}
+
+// Collector pauses next to range(0) live cells, range(1) selects the incremental,
+// the stop the world or the concurrent collector.
+// Every Run replaces a retained list, so the old generation fills with garbage and the major
+// collections run in the middle of the Runs.
+void BM_RunPauses(benchmark::State& state) {
+    Interpreter interpreter{EvalMode::BYTECODE};
+    Heap& heap = interpreter.GetHeap();
+    heap.SetIncremental(state.range(1) != kStopTheWorld);
+    heap.SetConcurrent(state.range(1) == kConcurrent);
+    interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+    interpreter.Run("(define live (range " + std::to_string(state.range(0)) + " '()))");
+    interpreter.Run("(define retained '())");
+    heap.ResetCollectorStats();
+
+    std::vector<double> latencies;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        interpreter.Run("(set! retained (range 100000 '()))");
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                .count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const CollectorStats& stats = heap.GetCollectorStats();
+    state.counters["p99_run_us"] = latencies[latencies.size() * 99 / 100];
+    state.counters["p99_pause_us"] = static_cast<double>(stats.GetPausePercentile(0.99).count());
+    state.counters["max_pause_us"] =
+        std::chrono::duration<double, std::micro>(stats.max_pause).count();
+    state.counters["pauses"] = static_cast<double>(stats.pauses);
+    state.counters["collections"] = static_cast<double>(stats.collections);
+    state.counters["cycles"] = static_cast<double>(stats.cycles);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Tokenize)->Arg(10'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReadToArena)->Arg(10'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReadToHeap)->Arg(10'000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_RunArithmetic)->ArgsProduct({{kBytecode, kTreeWalk}});
+BENCHMARK(BM_RunListBuilding)->ArgsProduct({{1'000}, {kBytecode, kTreeWalk}});
+BENCHMARK(BM_RunLambdaCalls)->ArgsProduct({{1'000}, {kBytecode, kTreeWalk}});
+BENCHMARK(BM_RunRecursion)->ArgsProduct({{1'000}, {kBytecode, kTreeWalk}});
+BENCHMARK(BM_RunFib)
+    ->ArgsProduct({{18}, {kBytecode, kTreeWalk}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_Collect)
+    ->ArgsProduct({{10'000, 100'000, 1'000'000}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Fixed iterations, the live heap is built once per run
+BENCHMARK(BM_RunPauses)
+    ->ArgsProduct({{1'000'000, 10'000'000}, {kIncremental, kStopTheWorld, kConcurrent}})
+    ->Iterations(1'000)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
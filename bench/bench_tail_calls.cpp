@@ -0,0 +1,52 @@
+#include <string>
+
+#include <sys/resource.h>
+
+#include <benchmark/benchmark.h>
+
+#include <scheme.h>
+
+namespace {
+
+int64_t MaxRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Peak RSS doesn't grow with the iterations count when tail calls run in constant memory
+void RunTailLoop(benchmark::State& state, EvalMode eval_mode) {
+    const std::string expression = "(loop " + std::to_string(state.range(0)) + " 0)";
+    Interpreter interpreter{eval_mode};
+    interpreter.Run("(define (loop n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1))))");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(interpreter.Run(expression));
+    }
+    state.counters["max_rss_kb"] = static_cast<double>(MaxRssKb());
+    state.counters["iterations_per_second"] = benchmark::Counter(
+        static_cast<double>(state.range(0) * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_TailLoopBytecode(benchmark::State& state) {
+    RunTailLoop(state, EvalMode::BYTECODE);
+}
+
+// Tree walker runs in constant C++ stack, the scopes of the loop are collected between tail calls
+void BM_TailLoopTreeWalk(benchmark::State& state) {
+    RunTailLoop(state, EvalMode::TREE_WALK);
+}
+
+}  // namespace
+
+BENCHMARK(BM_TailLoopBytecode)
+    ->RangeMultiplier(10)
+    ->Range(100'000, 10'000'000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TailLoopTreeWalk)
+    ->RangeMultiplier(10)
+    ->Range(100'000, 10'000'000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,65 @@
+#include <sstream>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <tokenizer.h>
+
+namespace {
+
+// Generated and indented script of range(0) definitions, like the large tables we load
+std::string MakeScript(int64_t definitions_count) {
+    std::string script;
+    for (int64_t i = 0; i < definitions_count; ++i) {
+        script += "(define (entry-" + std::to_string(i) + " x)\n    (if (< x " +
+                  std::to_string(i) + ")\n        '(1 2 . -3)\n        (list x #t #f)))\n";
+    }
+    return script;
+}
+
+size_t CountTokens(Tokenizer* tokenizer) {
+    size_t count = 0;
+    for (; !tokenizer->IsEnd(); tokenizer->Next()) {
+        ++count;
+    }
+    return count;
+}
+
+void BM_TokenizeStream(benchmark::State& state) {
+    const std::string script = MakeScript(state.range(0));
+    for (auto _ : state) {
+        std::stringstream ss{script};
+        Tokenizer tokenizer{&ss};
+        benchmark::DoNotOptimize(CountTokens(&tokenizer));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(script.size() * state.iterations()));
+}
+
+// range(1) is the SimdLevel of the structural scanner, SCALAR is the plain character loop
+void BM_TokenizeBuffer(benchmark::State& state) {
+    const std::string script = MakeScript(state.range(0));
+    SimdLevel previous_level = GetSimdLevel();
+    SetSimdLevel(static_cast<SimdLevel>(state.range(1)));
+    if (GetSimdLevel() != static_cast<SimdLevel>(state.range(1))) {
+        SetSimdLevel(previous_level);
+        state.SkipWithError("SIMD level isn't supported");
+        return;
+    }
+    for (auto _ : state) {
+        Tokenizer tokenizer{std::string_view{script}};
+        benchmark::DoNotOptimize(CountTokens(&tokenizer));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(script.size() * state.iterations()));
+    SetSimdLevel(previous_level);
+}
+
+}  // namespace
+
+BENCHMARK(BM_TokenizeStream)->Arg(100'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TokenizeBuffer)
+    ->ArgsProduct({{100'000},
+                   {static_cast<int64_t>(SimdLevel::SCALAR), static_cast<int64_t>(SimdLevel::SSE2),
+                    static_cast<int64_t>(SimdLevel::AVX2)}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
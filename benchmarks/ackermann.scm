@@ -0,0 +1,9 @@
+; Ackermann function A(3, n) = 2^(n + 3) - 3, the recursion is as deep as the result
+(define (ack m n)
+  (if (= m 0)
+      (+ n 1)
+      (if (= n 0)
+          (ack (- m 1) 1)
+          (ack (- m 1) (ack m (- n 1))))))
+
+(define (run n) (ack 3 n))
@@ -0,0 +1,29 @@
+; Symbolic derivative by x, repeated n times. There is no eq? to compare symbols,
+; so the operators are tags: (0 a b) is a + b, (1 a b) is a * b, (2 a b) is a - b.
+; Numbers are constants and any symbol is x.
+(define (deriv e)
+  (if (number? e)
+      0
+      (if (symbol? e)
+          1
+          (deriv-op (car e) (car (cdr e)) (car (cdr (cdr e)))))))
+
+(define (deriv-op op a b)
+  (if (= op 0)
+      (list 0 (deriv a) (deriv b))
+      (if (= op 1)
+          (list 0 (list 1 (deriv a) b) (list 1 a (deriv b)))
+          (list 2 (deriv a) (deriv b)))))
+
+; 3x^2 + 5x^2 + 7x - 9
+(define expression
+  (list 0
+        (list 0 (list 1 3 (list 1 'x 'x)) (list 1 5 (list 1 'x 'x)))
+        (list 2 (list 1 7 'x) 9)))
+
+(define (repeat n result)
+  (if (= n 0)
+      result
+      (repeat (- n 1) (deriv expression))))
+
+(define (run n) (repeat n '()))
@@ -0,0 +1,7 @@
+; Doubly recursive Fibonacci, (run n) makes about 2 * fib(n) calls
+(define (fib n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (run n) (fib n))
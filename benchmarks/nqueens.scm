@@ -0,0 +1,27 @@
+; Number of placements of n queens on an n x n board
+(define (one-to n acc)
+  (if (= n 0)
+      acc
+      (one-to (- n 1) (cons n acc))))
+
+(define (append-lists a b)
+  (if (null? a)
+      b
+      (cons (car a) (append-lists (cdr a) b))))
+
+(define (ok? row dist placed)
+  (if (null? placed)
+      #t
+      (and (not (= (car placed) (+ row dist)))
+           (not (= (car placed) (- row dist)))
+           (ok? row (+ dist 1) (cdr placed)))))
+
+(define (try-it x y z)
+  (if (null? x)
+      (if (null? y) 1 0)
+      (+ (if (ok? (car x) 1 z)
+             (try-it (append-lists (cdr x) y) '() (cons (car x) z))
+             0)
+         (try-it (cdr x) (cons (car x) y) z))))
+
+(define (run n) (try-it (one-to n '()) '() '()))
@@ -0,0 +1,153 @@
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <allocations_checker.h>
+#include <scheme.h>
+
+// Runs the programs of the benchmarks directory through Interpreter::Run.
+// Every program defines (run n), the runner calls it for each size and reports the wall time,
+// the allocations, the peak number of heap objects and the time of the collections.
+//
+// Usage: benchmark_runner [--tree-walk] [--dir=PATH] [name[=size,size...]]...
+// Without names all programs run with their default sizes.
+
+namespace {
+
+struct Program {
+    std::string name;
+    std::vector<int64_t> sizes;
+};
+
+const std::vector<Program> kPrograms = {{"fib", {15, 20, 25}},
+                                        {"tak", {4, 6, 8}},
+                                        {"ackermann", {4, 6, 8}},
+                                        {"nqueens", {6, 7, 8}},
+                                        {"deriv", {1'000, 5'000, 20'000}}};
+
+// Top level forms of the source, Run reads one expression at a time. Comments start with ;
+std::vector<std::string> SplitForms(const std::string& source) {
+    std::vector<std::string> forms;
+    std::string form;
+    int depth = 0;
+    bool is_comment = false;
+    for (char c : source) {
+        if (is_comment) {
+            is_comment = c != '\n';
+            continue;
+        }
+        if (c == ';') {
+            is_comment = true;
+            continue;
+        }
+        if (depth == 0 && std::isspace(static_cast<unsigned char>(c))) {
+            continue;
+        }
+        form += c;
+        if (c == '(') {
+            ++depth;
+        } else if (c == ')' && --depth == 0) {
+            forms.push_back(std::move(form));
+            form.clear();
+        }
+    }
+    if (depth != 0 || !form.empty()) {
+        throw SyntaxError{"Unbalanced parentheses in the program"};
+    }
+    return forms;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error{"Can't open " + path};
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+Program ParseProgram(std::string_view arg) {
+    size_t equal_sign = arg.find('=');
+    if (equal_sign == std::string_view::npos) {
+        for (const Program& program : kPrograms) {
+            if (program.name == arg) {
+                return program;
+            }
+        }
+        return {std::string{arg}, {1}};
+    }
+    Program program{std::string{arg.substr(0, equal_sign)}, {}};
+    std::stringstream sizes{std::string{arg.substr(equal_sign + 1)}};
+    for (std::string size; std::getline(sizes, size, ',');) {
+        program.sizes.push_back(std::stoll(size));
+    }
+    return program;
+}
+
+void RunProgram(const Program& program, const std::string& dir, EvalMode eval_mode) {
+    Interpreter interpreter{eval_mode};
+    for (const std::string& form : SplitForms(ReadFile(dir + "/" + program.name + ".scm"))) {
+        interpreter.Run(form);
+    }
+    Heap& heap = interpreter.GetHeap();
+    for (int64_t size : program.sizes) {
+        const std::string expression = "(run " + std::to_string(size) + ")";
+        heap.ResetCollectorStats();
+        size_t allocations = alloc_checker::AllocCount();
+        auto start = std::chrono::steady_clock::now();
+        std::string result = interpreter.Run(expression);
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        allocations = alloc_checker::AllocCount() - allocations;
+        const CollectorStats& stats = heap.GetCollectorStats();
+        if (result.size() > 20) {
+            result = result.substr(0, 17) + "...";
+        }
+        std::printf("%-10s %8lld %-20s %10.2f %12zu %10zu %8.2f %6zu\n", program.name.c_str(),
+                    static_cast<long long>(size), result.c_str(), time.count(), allocations,
+                    stats.peak_size,
+                    std::chrono::duration<double, std::milli>(stats.time).count(),
+                    stats.collections);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    EvalMode eval_mode = EvalMode::BYTECODE;
+    std::string dir = BENCHMARKS_DIR;
+    std::vector<Program> programs;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--tree-walk") {
+            eval_mode = EvalMode::TREE_WALK;
+        } else if (arg.starts_with("--dir=")) {
+            dir = arg.substr(6);
+        } else {
+            programs.push_back(ParseProgram(arg));
+        }
+    }
+    if (programs.empty()) {
+        programs = kPrograms;
+    }
+
+    std::printf("%-10s %8s %-20s %10s %12s %10s %8s %6s\n", "program", "size", "result",
+                "time_ms", "allocations", "peak_heap", "gc_ms", "gcs");
+    int status = 0;
+    for (const Program& program : programs) {
+        try {
+            RunProgram(program, dir, eval_mode);
+        } catch (const std::exception& error) {
+            std::fprintf(stderr, "%s: %s\n", program.name.c_str(), error.what());
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,9 @@
+; Takeuchi function, (run 6) is the classic (tak 18 12 6)
+(define (tak x y z)
+  (if (not (< y x))
+      z
+      (tak (tak (- x 1) y z)
+           (tak (- y 1) z x)
+           (tak (- z 1) x y))))
+
+(define (run n) (tak (* 3 n) (* 2 n) n))
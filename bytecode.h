@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+
+enum class OpCode : uint8_t {
+    CONST,          // push constants[arg]
+    LOAD_LOCAL,     // push slot arg of the frame depth levels up
+    LOAD_GLOBAL,    // push value of the global variable named by constants[arg], caches its slot
+    DEFINE_LOCAL,   // bind popped value to slot arg of the current frame, push ()
+    DEFINE_GLOBAL,  // bind popped value to global constants[arg], push ()
+    SET_LOCAL,      // rebind bound slot arg of the frame depth levels up, push ()
+    SET_GLOBAL,     // rebind existing global constants[arg] to popped value, push ()
+    POP,            // drop the top of the stack
+    JUMP,           // pc = arg
+    JUMP_IF_FALSE,  // pop, pc = arg if the value is #f
+    MAKE_CLOSURE,   // push closure of the Code in constants[arg] over the current frame
+    APPLY_FORM,     // skip the next JUMP unless the top is a special form, then pop it and
+                    // run it compiled over the argument syntax constants[arg], the code
+                    // is cached in constants[arg + 1] as (form . code)
+    CALL,           // call stack[top - arg] with the arg values above it
+    TAIL_CALL,      // CALL which replaces the current frame when it calls a closure
+    RETURN,         // leave the current frame with the top of the stack as result
+    FAIL_NIL,       // evaluation of () always fails
+};
+
+struct Instruction {
+    OpCode op;
+    uint16_t depth = 0;
+    uint32_t arg = 0;
+};
+
+// Compiled body of a lambda or of a top level expression
+class Code final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::CODE;
+
+private:
+    std::vector<Instruction> instructions_;
+    std::vector<Object*> constants_;
+    // Slot of the global binding resolved by the LOAD_GLOBAL of the same constant index
+    std::vector<Object**> global_slots_;
+    size_t args_count_ = 0;
+    size_t frame_size_ = 0;
+    // Names of the frame slots and the code of the lambda whose frame is the parent frame,
+    // special forms which are only known at run time are compiled with them and the locals
+    // read before their define are looked up by the name
+    std::vector<SymbolId> local_names_;
+    Code* parent_code_ = nullptr;
+
+public:
+    Code() noexcept : Object(kType) {
+    }
+
+    explicit Code(size_t args_count) noexcept : Object(kType), args_count_(args_count) {
+    }
+
+    const std::vector<Instruction>& GetInstructions() const noexcept {
+        return instructions_;
+    }
+
+    std::vector<Object*>& GetConstants() noexcept {
+        return constants_;
+    }
+
+    size_t GetArgsCount() const noexcept {
+        return args_count_;
+    }
+
+    // Arguments are followed by the variables defined in the body
+    size_t GetFrameSize() const noexcept {
+        return frame_size_;
+    }
+
+    void SetFrameSize(size_t frame_size) noexcept {
+        frame_size_ = frame_size;
+    }
+
+    const std::vector<SymbolId>& GetLocalNames() const noexcept {
+        return local_names_;
+    }
+
+    Code* GetParentCode() noexcept {
+        return parent_code_;
+    }
+
+    void SetLocals(std::vector<SymbolId> local_names, Code* parent_code) noexcept {
+        local_names_ = std::move(local_names);
+        parent_code_ = parent_code;
+    }
+
+    size_t Emit(OpCode op, uint32_t arg = 0, uint16_t depth = 0) {
+        instructions_.push_back({op, depth, arg});
+        return instructions_.size() - 1;
+    }
+
+    // Jump targets are known only after the branch is emitted
+    void Patch(size_t index, uint32_t arg) noexcept {
+        instructions_[index].arg = arg;
+    }
+
+    size_t Size() const noexcept {
+        return instructions_.size();
+    }
+
+    uint32_t AddConstant(Object* constant) {
+        constants_.push_back(constant);
+        global_slots_.push_back(nullptr);
+        return constants_.size() - 1;
+    }
+
+    // Every LOAD_GLOBAL has its own constant, so this is a cache of one call site
+    Object**& GetGlobalSlot(uint32_t index) noexcept {
+        return global_slots_[index];
+    }
+
+    void Trace(std::vector<Object*>* references) override {
+        references->insert(references->end(), constants_.begin(), constants_.end());
+        references->push_back(parent_code_);
+    }
+
+    void TraceSlots(std::vector<Object**>* slots) override {
+        for (Object*& constant : constants_) {
+            slots->push_back(&constant);
+        }
+    }
+};
+
+// Variables of one lambda call addressed by slot, replaces Scope in the VM
+class Frame final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::FRAME;
+
+private:
+    std::vector<Object*> slots_;
+    Frame* parent_frame_ = nullptr;
+
+public:
+    // Marks slots of the body defines which haven't been executed yet, the VM looks such
+    // variables up in the enclosing frames and in the global scope
+    static Object* const kUnbound;
+
+    Frame(size_t size, Frame* parent_frame)
+            : Object(kType), slots_(size, kUnbound), parent_frame_(parent_frame) {
+    }
+
+    Object*& operator[](size_t slot) noexcept {
+        return slots_[slot];
+    }
+
+    Frame* GetParentFrame() noexcept {
+        return parent_frame_;
+    }
+
+    std::vector<Object*>& GetSlots() noexcept {
+        return slots_;
+    }
+
+    void Trace(std::vector<Object*>* references) override {
+        references->push_back(parent_frame_);
+        references->insert(references->end(), slots_.begin(), slots_.end());
+    }
+
+    void TraceSlots(std::vector<Object**>* slots) override {
+        for (Object*& slot : slots_) {
+            slots->push_back(&slot);
+        }
+    }
+};
+
+// Lambda created by the VM: compiled body plus captured frame
+class Closure final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::CLOSURE;
+
+private:
+    Code* code_ = nullptr;
+    Frame* frame_ = nullptr;
+
+public:
+    Closure(Code* code, Frame* frame) noexcept : Object(kType), code_(code), frame_(frame) {
+    }
+
+    Code* GetCode() noexcept {
+        return code_;
+    }
+
+    // nullptr for lambdas created at the top level
+    Frame* GetFrame() noexcept {
+        return frame_;
+    }
+
+    void Trace(std::vector<Object*>* references) override {
+        references->push_back(code_);
+        references->push_back(frame_);
+    }
+};
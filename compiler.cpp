@@ -0,0 +1,400 @@
+#include "compiler.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+Object unbound_marker{Generation::PERMANENT};
+
+}  // namespace
+
+Object* const Frame::kUnbound = &unbound_marker;
+
+Code* Compiler::Compile(Object* expression) {
+    code_ = heap_->Make<Code>();
+    locals_ = nullptr;
+    frame_code_ = nullptr;
+    CompileExpression(expression, true);
+    code_->Emit(OpCode::RETURN);
+    return code_;
+}
+
+Code* Compiler::CompileForm(Function* form, Object* tail, Code* frame_code) {
+    std::vector<LocalNames> frames_locals;
+    for (Code* lambda_code = frame_code; lambda_code; lambda_code = lambda_code->GetParentCode()) {
+        frames_locals.push_back({lambda_code->GetLocalNames(), nullptr, true});
+    }
+    for (size_t i = 1; i < frames_locals.size(); ++i) {
+        frames_locals[i - 1].parent = &frames_locals[i];
+    }
+    code_ = heap_->Make<Code>();
+    locals_ = frames_locals.empty() ? nullptr : &frames_locals.front();
+    frame_code_ = frame_code;
+    // Forms applied by this code run in the same frame
+    if (frame_code) {
+        code_->SetLocals(frame_code->GetLocalNames(), frame_code->GetParentCode());
+        heap_->WriteBarrier(code_, frame_code->GetParentCode());
+    }
+    if (!CompileSpecialForm(form, tail, false)) {
+        throw RuntimeError{"didn't support (...) without function"};
+    }
+    code_->Emit(OpCode::RETURN);
+    return code_;
+}
+
+uint32_t Compiler::AddConstant(Object* constant) {
+    uint32_t index = code_->AddConstant(constant);
+    heap_->WriteBarrier(code_, constant);
+    return index;
+}
+
+void Compiler::CompileExpression(Object* expression, bool is_tail) {
+    if (!expression) {
+        code_->Emit(OpCode::FAIL_NIL);
+        return;
+    }
+    if (Is<Symbol>(expression)) {
+        CompileVariable(expression, OpCode::LOAD_LOCAL, OpCode::LOAD_GLOBAL);
+        return;
+    }
+    if (!Is<Cell>(expression)) {  // self evaluating
+        code_->Emit(OpCode::CONST, AddConstant(heap_->Promote(expression)));
+        return;
+    }
+    Object* head = As<Cell>(expression)->GetFirst();
+    Object* tail = As<Cell>(expression)->GetSecond();
+    if (!head) {
+        code_->Emit(OpCode::FAIL_NIL);
+        return;
+    }
+    // Process incorrect pairs
+    if (Is<Symbol>(head) && As<Symbol>(head)->GetId() == SymbolTable::kDot) {
+        throw SyntaxError{"This syntax didn't support"};
+    }
+    if (!CompileSpecialForm(FindSpecialForm(head), tail, is_tail)) {
+        CompileCall(head, tail, is_tail);
+    }
+}
+
+bool Compiler::CompileSpecialForm(Function* form, Object* tail, bool is_tail) {
+    if (Is<Quote>(form)) {
+        code_->Emit(OpCode::CONST, AddConstant(heap_->Promote(Quote::GetValue(tail))));
+    } else if (Is<If>(form)) {
+        CompileIf(tail, is_tail);
+    } else if (Is<Define>(form)) {
+        CompileDefine(tail);
+    } else if (Is<Set>(form)) {
+        CompileSet(tail);
+    } else if (Is<MakeLambda>(form)) {
+        CompileLambda(tail);
+    } else if (Is<And>(form)) {
+        CompileBoolOperator(tail, true, is_tail);
+    } else if (Is<Or>(form)) {
+        CompileBoolOperator(tail, false, is_tail);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Compiler::CompileCall(Object* head, Object* tail, bool is_tail_call) {
+    CompileExpression(head);
+    // The head may be a special form passed as a value, which needs the syntax of the arguments.
+    // The arguments are compiled from the copy, so the calls nested in them don't copy it again.
+    tail = heap_->Promote(tail);
+    code_->Emit(OpCode::APPLY_FORM, AddConstant(tail));
+    AddConstant(nullptr);
+    size_t to_end = code_->Emit(OpCode::JUMP);
+    uint32_t args_count = 0;
+    while (Is<Cell>(tail)) {
+        CompileExpression(As<Cell>(tail)->GetFirst());
+        ++args_count;
+        tail = As<Cell>(tail)->GetSecond();
+    }
+    if (tail) {  // corner case, same as in GetVectorFromCell
+        code_->Emit(OpCode::CONST, AddConstant(heap_->Promote(tail)));
+        ++args_count;
+    }
+    code_->Emit(is_tail_call ? OpCode::TAIL_CALL : OpCode::CALL, args_count);
+    code_->Patch(to_end, code_->Size());
+}
+
+void Compiler::CompileIf(Object* tail, bool is_tail) {
+    if (!tail || !Is<Cell>(tail)) {
+        throw SyntaxError{"if expected 1 or 2 arguments and maybe return value as 3 argument"};
+    }
+    std::vector<Object*> args = GetVectorFromCell(tail, nullptr, false);
+    if (args.size() == 1) {
+        code_->Emit(OpCode::CONST,
+                    AddConstant(heap_->Make<Cell>(nullptr, nullptr)));
+        return;
+    }
+    if (args.size() > 3) {
+        throw SyntaxError{"if expected 1 or 2 arguments and maybe return value as 3 argument"};
+    }
+    CompileExpression(args[0]);
+    size_t to_false_branch = code_->Emit(OpCode::JUMP_IF_FALSE);
+    CompileExpression(args[1], is_tail);  // true branch
+    size_t to_end = code_->Emit(OpCode::JUMP);
+    code_->Patch(to_false_branch, code_->Size());
+    if (args.size() > 2) {
+        CompileExpression(args[2], is_tail);  // false branch
+    } else {
+        code_->Emit(OpCode::CONST, AddConstant(nullptr));
+    }
+    code_->Patch(to_end, code_->Size());
+}
+
+void Compiler::CompileDefine(Object* tail) {
+    if (!tail || !Is<Cell>(tail) || !As<Cell>(tail)->GetSecond()) {
+        throw SyntaxError{"Invalid args Define 1"};
+    }
+    std::vector<Object*> args = GetVectorFromCell(tail, nullptr, false);
+    if (args.size() < 2) {
+        throw SyntaxError{"Invalid args Define 2"};
+    }
+    if (!Is<Cell>(args[0])) {  // if it variable
+        if (args.size() != 2) {
+            throw SyntaxError{"Invalid args in Define"};
+        }
+        if (!Is<Symbol>(args[0])) {
+            throw SyntaxError{"Invalid args Define 3"};
+        }
+        if (!args[1]) {
+            throw SyntaxError{"Invalid args Define 4"};
+        }
+        CompileExpression(args[1]);
+        CompileDefinition(args[0]);
+    } else {  // if it lambda
+        std::vector<Object*> lambda_header = GetVectorFromCell(args[0], nullptr, false);
+        if (!Is<Symbol>(lambda_header[0])) {
+            throw SyntaxError{"Invalid args Define 5"};
+        }
+        std::vector<SymbolId> lambda_args = ReadParams(lambda_header, 1);
+        std::vector<Object*> lambda_body(args.begin() + 1, args.end());
+        Code* lambda_code = CompileBody(std::move(lambda_args), lambda_body);
+        code_->Emit(OpCode::MAKE_CLOSURE, AddConstant(lambda_code));
+        CompileDefinition(lambda_header[0]);
+    }
+}
+
+void Compiler::CompileSet(Object* tail) {
+    if (!tail || !Is<Cell>(tail) || !As<Cell>(tail)->GetSecond()) {
+        throw SyntaxError{"Invalid args Set 1"};
+    }
+    std::vector<Object*> args = GetVectorFromCell(tail, nullptr, false);
+    if (args.size() != 2) {
+        throw SyntaxError{"Invalid args Set 2"};
+    }
+    if (Is<Cell>(args[0])) {
+        throw SyntaxError{"Invalid args Set 6"};
+    }
+    if (!Is<Symbol>(args[0])) {
+        throw SyntaxError{"Invalid args Set 3"};
+    }
+    if (!args[1]) {
+        throw SyntaxError{"Invalid args Set 5"};
+    }
+    CompileExpression(args[1]);
+    CompileVariable(args[0], OpCode::SET_LOCAL, OpCode::SET_GLOBAL);
+}
+
+void Compiler::CompileLambda(Object* tail) {
+    if (!tail || !Is<Cell>(tail)) {
+        throw SyntaxError{"Invalid args in make Lambda 1"};
+    }
+    std::vector<Object*> args = GetVectorFromCell(tail, nullptr, false);
+    if (args.size() < 2) {
+        throw SyntaxError{"Invalid args in make Lambda 2"};
+    }
+    std::vector<SymbolId> lambda_args;
+    if (args[0]) {
+        lambda_args = ReadParams(GetVectorFromCell(args[0], nullptr, false), 0);
+    }
+    std::vector<Object*> lambda_body(args.begin() + 1, args.end());
+    Code* lambda_code = CompileBody(std::move(lambda_args), lambda_body);
+    code_->Emit(OpCode::MAKE_CLOSURE, AddConstant(lambda_code));
+}
+
+void Compiler::CompileBoolOperator(Object* tail, bool is_and, bool is_tail) {
+    if (!tail) {
+        code_->Emit(OpCode::CONST, AddConstant(Bool::Get(is_and)));
+        return;
+    }
+    if (!Is<Cell>(tail) || !As<Cell>(tail)->GetFirst()) {
+        throw RuntimeError{"Incorrect cell"};
+    }
+    // (and a b c) -> a ? (b ? c : #f) : #f
+    // (or a b c)  -> a ? #t : (b ? #t : c)
+    std::vector<size_t> to_end;
+    std::vector<size_t> to_false;
+    uint32_t short_circuit = AddConstant(Bool::Get(!is_and));
+    while (Is<Cell>(tail)) {
+        Object* expression = As<Cell>(tail)->GetFirst();
+        tail = As<Cell>(tail)->GetSecond();
+        if (!Is<Cell>(tail)) {  // last value is the result
+            CompileExpression(expression, is_tail);
+            break;
+        }
+        CompileExpression(expression);
+        size_t jump = code_->Emit(OpCode::JUMP_IF_FALSE);
+        if (is_and) {
+            to_false.push_back(jump);
+        } else {
+            code_->Emit(OpCode::CONST, short_circuit);
+            to_end.push_back(code_->Emit(OpCode::JUMP));
+            code_->Patch(jump, code_->Size());
+        }
+    }
+    if (!to_false.empty()) {
+        to_end.push_back(code_->Emit(OpCode::JUMP));
+        for (size_t jump : to_false) {
+            code_->Patch(jump, code_->Size());
+        }
+        code_->Emit(OpCode::CONST, short_circuit);
+    }
+    for (size_t jump : to_end) {
+        code_->Patch(jump, code_->Size());
+    }
+}
+
+void Compiler::CompileVariable(Object* symbol, OpCode local_op, OpCode global_op) {
+    auto address = Resolve(As<Symbol>(symbol)->GetId());
+    if (address) {
+        code_->Emit(local_op, address->slot, address->depth);
+    } else {
+        code_->Emit(global_op, AddConstant(symbol));
+    }
+}
+
+void Compiler::CompileDefinition(Object* symbol) {
+    if (!locals_) {
+        code_->Emit(OpCode::DEFINE_GLOBAL, AddConstant(symbol));
+        return;
+    }
+    // Defines are collected before the body is compiled, so the slot usually exists
+    SymbolId name = As<Symbol>(symbol)->GetId();
+    auto& names = locals_->names;
+    auto name_it = std::find(names.rbegin(), names.rend(), name);
+    if (name_it == names.rend()) {
+        if (locals_->is_closed) {
+            throw RuntimeError{"Can't define a new local variable by a define passed as a value"};
+        }
+        names.push_back(name);
+        name_it = names.rbegin();
+    }
+    code_->Emit(OpCode::DEFINE_LOCAL, names.rend() - name_it - 1);
+}
+
+Code* Compiler::CompileBody(std::vector<SymbolId> params, const std::vector<Object*>& body) {
+    Code* lambda_code = heap_->Make<Code>(params.size());
+    LocalNames lambda_locals{std::move(params), locals_};
+
+    Code* outer_code = code_;
+    LocalNames* outer_locals = locals_;
+    Code* outer_frame_code = frame_code_;
+    code_ = lambda_code;
+    locals_ = &lambda_locals;
+    frame_code_ = lambda_code;
+    for (Object* form : body) {
+        CollectDefines(form, &lambda_locals.names);
+    }
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (i) {
+            code_->Emit(OpCode::POP);
+        }
+        CompileExpression(body[i], i + 1 == body.size());
+    }
+    code_->Emit(OpCode::RETURN);
+    code_->SetFrameSize(lambda_locals.names.size());
+    code_->SetLocals(std::move(lambda_locals.names), outer_frame_code);
+    heap_->WriteBarrier(code_, outer_frame_code);
+    code_ = outer_code;
+    locals_ = outer_locals;
+    frame_code_ = outer_frame_code;
+    return lambda_code;
+}
+
+std::vector<SymbolId> Compiler::ReadParams(const std::vector<Object*>& symbols,
+                                           size_t from) const {
+    std::vector<SymbolId> params;
+    params.reserve(symbols.size() - from);
+    for (size_t i = from; i < symbols.size(); ++i) {
+        if (!Is<Symbol>(symbols[i])) {
+            throw SyntaxError{"Invalid args in make Lambda 3"};
+        }
+        params.push_back(As<Symbol>(symbols[i])->GetId());
+    }
+    return params;
+}
+
+Function* Compiler::FindSpecialForm(Object* head) const {
+    if (!Is<Symbol>(head)) {
+        return nullptr;
+    }
+    SymbolId name = As<Symbol>(head)->GetId();
+    if (Resolve(name)) {
+        return nullptr;
+    }
+    Object** variable = global_scope_->Lookup(name);
+    if (!variable) {
+        return nullptr;
+    }
+    Object* value = *variable;
+    if (Is<Quote>(value) || Is<If>(value) || Is<Define>(value) || Is<Set>(value) ||
+        Is<MakeLambda>(value) || Is<And>(value) || Is<Or>(value)) {
+        return As<Function>(value);
+    }
+    return nullptr;
+}
+
+std::optional<Compiler::LocalAddress> Compiler::Resolve(SymbolId name) const {
+    size_t depth = 0;
+    for (LocalNames* locals = locals_; locals; locals = locals->parent, ++depth) {
+        // the latest binding wins if the name repeats
+        auto name_it = std::find(locals->names.rbegin(), locals->names.rend(), name);
+        if (name_it != locals->names.rend()) {
+            if (depth > std::numeric_limits<uint16_t>::max()) {
+                throw RuntimeError{"Too deep lambda nesting"};
+            }
+            uint32_t slot = locals->names.rend() - name_it - 1;
+            return LocalAddress{static_cast<uint16_t>(depth), slot};
+        }
+    }
+    return std::nullopt;
+}
+
+// Variables defined inside of a lambda body shadow the global special forms
+void Compiler::CollectDefines(Object* form, std::vector<SymbolId>* names) const {
+    if (!Is<Cell>(form)) {
+        return;
+    }
+    Function* special_form = FindSpecialForm(As<Cell>(form)->GetFirst());
+    if (Is<Quote>(special_form) || Is<MakeLambda>(special_form)) {
+        return;
+    }
+    Object* tail = As<Cell>(form)->GetSecond();
+    if (Is<Define>(special_form) && Is<Cell>(tail)) {
+        Object* target = As<Cell>(tail)->GetFirst();
+        bool is_lambda = Is<Cell>(target);
+        if (is_lambda) {
+            target = As<Cell>(target)->GetFirst();
+        }
+        if (Is<Symbol>(target)) {
+            SymbolId name = As<Symbol>(target)->GetId();
+            if (std::find(names->begin(), names->end(), name) == names->end()) {
+                names->push_back(name);
+            }
+        }
+        if (is_lambda) {
+            return;  // body of the defined lambda has its own locals
+        }
+        tail = As<Cell>(tail)->GetSecond();
+    }
+    while (Is<Cell>(tail)) {
+        CollectDefines(As<Cell>(tail)->GetFirst(), names);
+        tail = As<Cell>(tail)->GetSecond();
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "bytecode.h"
+
+// Translates the AST produced by Read() into bytecode for the Interpreter VM. The AST may be
+// in a SyntaxArena, so the syntax which becomes a constant of the code is promoted to the heap.
+// Special forms are resolved at compile time: a head symbol which is not shadowed by a local
+// variable and is bound to a special form in the global scope is compiled into opcodes.
+// Variables of the enclosing lambdas are resolved into (depth, slot) addresses, everything
+// else is looked up by the symbol id in the global scope.
+// A call whose head evaluates to a special form at run time is compiled by CompileForm from
+// the syntax of its arguments, with the locals of the frame the call runs in.
+class Compiler {
+private:
+    // Variables of one lambda, index of the name is its slot in the Frame
+    struct LocalNames {
+        std::vector<SymbolId> names;
+        LocalNames* parent = nullptr;
+        // Frame exists already, so it can't get new slots
+        bool is_closed = false;
+    };
+
+    struct LocalAddress {
+        uint16_t depth;
+        uint32_t slot;
+    };
+
+    Heap* heap_;
+    Scope* global_scope_;
+    Code* code_ = nullptr;
+    LocalNames* locals_ = nullptr;
+    // Lambda whose frame holds locals_, nullptr at the top level
+    Code* frame_code_ = nullptr;
+
+public:
+    Compiler(Heap* heap, Scope* global_scope) : heap_(heap), global_scope_(global_scope) {
+    }
+
+    // Compiles top level expression, the result is evaluated in the global scope
+    Code* Compile(Object* expression);
+
+    // Compiles the application of form to the argument syntax tail. The result runs in the
+    // frame of frame_code, which is nullptr at the top level.
+    Code* CompileForm(Function* form, Object* tail, Code* frame_code);
+
+private:
+    // is_tail is set for expressions whose value is the result of the whole lambda body
+    void CompileExpression(Object* expression, bool is_tail = false);
+
+    // Returns false if form isn't a special form which is compiled into opcodes
+    bool CompileSpecialForm(Function* form, Object* tail, bool is_tail);
+
+    void CompileCall(Object* head, Object* tail, bool is_tail_call);
+
+    void CompileIf(Object* tail, bool is_tail);
+
+    void CompileDefine(Object* tail);
+
+    void CompileSet(Object* tail);
+
+    void CompileLambda(Object* tail);
+
+    void CompileBoolOperator(Object* tail, bool is_and, bool is_tail);
+
+    void CompileVariable(Object* symbol, OpCode local_op, OpCode global_op);
+
+    void CompileDefinition(Object* symbol);
+
+    Code* CompileBody(std::vector<SymbolId> params, const std::vector<Object*>& body);
+
+    std::vector<SymbolId> ReadParams(const std::vector<Object*>& symbols, size_t from) const;
+
+    // Constants are allocated while the code is compiled, so the code may be older than them
+    uint32_t AddConstant(Object* constant);
+
+    Function* FindSpecialForm(Object* head) const;
+
+    std::optional<LocalAddress> Resolve(SymbolId name) const;
+
+    void CollectDefines(Object* form, std::vector<SymbolId>* names) const;
+};
@@ -1,5 +1,12 @@
 #include "object.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+#include "bytecode.h"
+
 // todo: Decompose this
 
 std::vector<Object*> GetVectorFromCell(Object* cell_head, Scope* scope, bool eval) {
@@ -26,37 +33,184 @@ std::vector<Object*> GetVectorFromCell(Object* cell_head, Scope* scope, bool eva
     return cell_vector;
 }
 
+namespace {
+
+// Calls f for every part of the list like GetVectorFromCell does without eval,
+// including the tail of an improper list. Returns the number of parts.
+template <class F>
+size_t ForEachPart(Object* cell_head, F&& f) {
+    size_t count = 0;
+    for (; Is<Cell>(cell_head); cell_head = As<Cell>(cell_head)->GetSecond(), ++count) {
+        f(As<Cell>(cell_head)->GetFirst());
+    }
+    if (cell_head) {  // corner case
+        f(cell_head);
+        ++count;
+    }
+    return count;
+}
+
+size_t CountParts(Object* cell_head) {
+    return ForEachPart(cell_head, [](Object*) {});
+}
+
+// The first parts.size() parts of the form, returns the number of all parts
+size_t GetParts(Object* cell_head, std::span<Object*> parts) {
+    size_t index = 0;
+    return ForEachPart(cell_head, [parts, &index](Object* part) {
+        if (index < parts.size()) {
+            parts[index] = part;
+        }
+        ++index;
+    });
+}
+
+// Parts from the first one are the body of a lambda
+std::vector<Object*> GetBody(Object* cell_head) {
+    std::vector<Object*> body;
+    body.reserve(CountParts(cell_head));
+    ForEachPart(cell_head, [&body](Object* part) { body.push_back(part); });
+    return body;
+}
+
+std::vector<SymbolId> GetParams(Object* cell_head, const char* error) {
+    std::vector<SymbolId> params;
+    params.reserve(CountParts(cell_head));
+    ForEachPart(cell_head, [&params, error](Object* part) {
+        if (!Is<Symbol>(part)) {
+            throw SyntaxError{error};
+        }
+        params.push_back(As<Symbol>(part)->GetId());
+    });
+    return params;
+}
+
+// Links the roots of an evaluation to the heap while it runs, also when it throws
+class EvalRootsGuard {
+private:
+    Heap* heap_;
+    EvalRoots node_;
+
+public:
+    EvalRootsGuard(Heap* heap, std::span<Object* const> objects) noexcept
+            : heap_(heap), node_{objects, heap->GetEvalRoots()} {
+        heap_->SetEvalRoots(&node_);
+    }
+
+    EvalRootsGuard(const EvalRootsGuard&) = delete;
+
+    EvalRootsGuard& operator=(const EvalRootsGuard&) = delete;
+
+    ~EvalRootsGuard() {
+        heap_->SetEvalRoots(node_.outer);
+    }
+
+    void Reset(std::span<Object* const> objects) noexcept {
+        node_.objects = objects;
+    }
+};
+
+// Evaluated arguments of a tree walker call, the first kInlineArgsCount are kept in place
+class Arguments {
+private:
+    std::array<Object*, Procedure::kInlineArgsCount> inline_args_;
+    std::vector<Object*> spilled_args_;
+    size_t size_ = 0;
+
+public:
+    void PushBack(Object* arg) {
+        if (size_ < inline_args_.size()) {
+            inline_args_[size_++] = arg;
+            return;
+        }
+        if (spilled_args_.empty()) {
+            spilled_args_.assign(inline_args_.begin(), inline_args_.end());
+        }
+        spilled_args_.push_back(arg);
+        ++size_;
+    }
+
+    std::span<Object*> GetSpan() noexcept {
+        if (size_ <= inline_args_.size()) {
+            return {inline_args_.data(), size_};
+        }
+        return spilled_args_;
+    }
+};
+
+}  // namespace
+
 Object* Symbol::Eval(Scope* scope) {
-    if (!scope->Find(name_)) {
+    Object** value = scope->Lookup(id_);
+    if (!value) {
         throw NameError{"Undefined command " + name_};
     }
-    return scope->Get(name_);
+    return *value;
 }
 
 Object* Cell::Eval(Scope* scope) {
-    if (!head_) {
-        throw RuntimeError{"Error in eval of cell head"};
-    }
-    // Process incorrect pairs
-    if (Is<Symbol>(head_) && As<Symbol>(head_)->GetName() == ".") {
-        throw SyntaxError{"This syntax didn't support"};
-    }
-    // Get evaluate of head
-    auto eval_head = head_->Eval(scope);
-    if (!eval_head) {
-        throw RuntimeError{"Error in cell eval"};
-    }
-    if (Is<Lambda>(eval_head)) {
-        Lambda* lambda_func = As<Lambda>(eval_head);
-        return lambda_func->Apply(tail_, scope);
+    Cell* expression = this;
+    // Expression, scope and callee of this evaluation are the roots of the safe points
+    Heap* heap = scope->GetHeap();
+    Object* roots[] = {expression, scope, nullptr};
+    EvalRootsGuard roots_guard{heap, roots};
+    // Expressions in tail position are evaluated here instead of a recursive Eval
+    while (true) {
+        Object* head = expression->head_;
+        if (!head) {
+            throw RuntimeError{"Error in eval of cell head"};
+        }
+        if (IsFixnum(head)) {
+            throw RuntimeError{"didn't support (...) without function"};
+        }
+        // Get evaluate of head, the usual heads are evaluated without a virtual call
+        Object* eval_head;
+        switch (head->GetType()) {
+            case ObjectType::SYMBOL:
+                // Process incorrect pairs
+                if (static_cast<Symbol*>(head)->GetId() == SymbolTable::kDot) {
+                    throw SyntaxError{"This syntax didn't support"};
+                }
+                eval_head = static_cast<Symbol*>(head)->Eval(scope);
+                break;
+            case ObjectType::CELL:
+                eval_head = static_cast<Cell*>(head)->Eval(scope);
+                break;
+            default:
+                eval_head = head->Eval(scope);
+        }
+        if (!eval_head) {
+            throw RuntimeError{"Error in cell eval"};
+        }
+        if (!Is<Function>(eval_head)) {
+            throw RuntimeError{"didn't support (...) without function"};
+        }
+        roots[2] = eval_head;
+        bool is_tail_call = false;
+        Object* result = static_cast<Function*>(eval_head)->ApplyTail(expression->tail_, &scope,
+                                                                      &is_tail_call);
+        if (!is_tail_call) {
+            return result;
+        }
+        if (!result) {
+            throw RuntimeError{"Error in eval of cell head"};
+        }
+        if (!Is<Cell>(result)) {
+            return result->Eval(scope);
+        }
+        expression = As<Cell>(result);
+        roots[0] = expression;
+        roots[1] = scope;
+        roots[2] = nullptr;
+        heap->SafePoint();
     }
-    if (Is<Function>(eval_head)) {
-        // Convert it to function
-        Function* func = As<Function>(eval_head);
-        // and apply it to tail
-        return func->Apply(tail_, scope);
+}
+
+std::string SerializeObject(Object* object) {
+    if (IsFixnum(object)) {
+        return std::to_string(GetNumeric(object));
     }
-    throw RuntimeError{"didn't support (...) without function"};
+    return object->Serialize();
 }
 
 std::string Cell::Serialize() {
@@ -74,11 +228,11 @@ std::string Cell::Serialize() {
         if (!next_head) {
             throw RuntimeError{"Error in Serialize"};
         }
-        result += next_head->Serialize();
+        result += SerializeObject(next_head);
         auto next_tail = As<Cell>(current_head)->GetSecond();
         if (next_tail && !Is<Cell>(next_tail)) {  // is pair or proper
             result += " . ";
-            result += next_tail->Serialize();
+            result += SerializeObject(next_tail);
             break;
         }
         current_head = next_tail;
@@ -92,8 +246,12 @@ std::string Cell::Serialize() {
 }
 
 Object* Quote::Apply(Object* head, Scope*) {
+    return GetValue(head);
+}
+
+Object* Quote::GetValue(Object* head) {
     if (Is<Cell>(head) && !As<Cell>(head)->GetSecond()) {
-        if (!As<Cell>(head)->GetFirst() || Is<Number>(As<Cell>(head)->GetFirst())) {
+        if (!As<Cell>(head)->GetFirst() || IsNumeric(As<Cell>(head)->GetFirst())) {
             return head;
         }
         return As<Cell>(head)->GetFirst();
@@ -101,79 +259,79 @@ Object* Quote::Apply(Object* head, Scope*) {
     return head;
 }
 
-Object* CheckType::Apply(Object* head, Scope* scope) {
-    if (!head) {
-        throw RuntimeError{"Incorrect args"};
+Object* Function::ApplyByTail(Object* head, Scope* scope) {
+    bool is_tail_call = false;
+    Object* result = ApplyTail(head, &scope, &is_tail_call);
+    if (!is_tail_call) {
+        return result;
     }
-    return Heap::Instance().Make<Bool>(IsTypeOf(head, scope));
+    if (!result) {
+        throw RuntimeError{"Error in eval of cell head"};
+    }
+    return result->Eval(scope);
 }
 
-bool IsBool::IsTypeOf(Object* target_object, Scope* scope) {
-    if (!Is<Cell>(target_object)) {
-        return Is<Bool>(target_object);
+Object* Procedure::Apply(Object* head, Scope* scope) {
+    if (!head) {
+        return Call({});
     }
-    if (As<Cell>(target_object)->GetSecond()) {
-        throw RuntimeError{"Incorrect args"};
+    if (!Is<Cell>(head)) {
+        throw RuntimeError{"Incorrect args type!"};
     }
-    if (!As<Cell>(target_object)->GetFirst()) {
-        return false;
+    Arguments args;
+    EvalRootsGuard roots_guard{scope->GetHeap(), {}};
+    for (; Is<Cell>(head); head = As<Cell>(head)->GetSecond()) {
+        if (!As<Cell>(head)->GetFirst()) {
+            throw RuntimeError{"Incorrect args type"};
+        }
+        args.PushBack(As<Cell>(head)->GetFirst()->Eval(scope));
+        roots_guard.Reset(args.GetSpan());
+    }
+    if (head) {  // corner case, same as in GetVectorFromCell
+        args.PushBack(head);
     }
-    return Is<Bool>(As<Cell>(target_object)->GetFirst()->Eval(scope));
+    return CallWith(args.GetSpan());
 }
 
-bool IsNumber::IsTypeOf(Object* target_object, Scope* scope) {
-    if (!Is<Cell>(target_object)) {
-        return Is<Number>(target_object);
-    }
-    if (As<Cell>(target_object)->GetSecond()) {
+Object* CheckType::Call(std::span<Object*> args) {
+    if (args.size() != 1) {
         throw RuntimeError{"Incorrect args"};
     }
-    if (!As<Cell>(target_object)->GetFirst()) {
-        return false;
-    }
-    return Is<Number>(As<Cell>(target_object)->GetFirst()->Eval(scope));
+    return Call1(args[0]);
 }
 
-bool IsSymbol::IsTypeOf(Object* target_object, Scope* scope) {
-    if (!Is<Cell>(target_object)) {
-        return Is<Symbol>(target_object);
-    }
-    if (As<Cell>(target_object)->GetSecond()) {
-        throw RuntimeError{"Incorrect args"};
-    }
-    if (!As<Cell>(target_object)->GetFirst()) {
-        return false;
-    }
-    return Is<Symbol>(As<Cell>(target_object)->GetFirst()->Eval(scope));
+bool IsBool::IsTypeOf(Object* target_object) {
+    return Is<Bool>(target_object);
+}
+
+bool IsNumber::IsTypeOf(Object* target_object) {
+    return IsNumeric(target_object);
+}
+
+bool IsSymbol::IsTypeOf(Object* target_object) {
+    return Is<Symbol>(target_object);
 }
 
-bool IsPair::IsTypeOf(Object* target_object, Scope* scope) {
+bool IsPair::IsTypeOf(Object* target_object) {
     if (!Is<Cell>(target_object)) {
         return false;
     }
-    auto current_head = As<Cell>(As<Cell>(target_object)->GetFirst()->Eval(scope));
-    if (!current_head) {
-        return false;
-    }
-    std::vector<Object*> args = GetVectorFromCell(current_head, scope);
-    return args.size() == 2;
+    return CountParts(target_object) == 2;
 }
 
-bool IsNull::IsTypeOf(Object* target_object, Scope* scope) {
-    auto current_head = As<Cell>(target_object)->GetFirst()->Eval(scope);
-    return !current_head;
+bool IsNull::IsTypeOf(Object* target_object) {
+    return !target_object;
 }
 
-bool IsList::IsTypeOf(Object* target_object, Scope* scope) {
+bool IsList::IsTypeOf(Object* target_object) {
+    if (!target_object) {  // empty
+        return true;
+    }
     if (!Is<Cell>(target_object)) {  // corner
         return false;
     }
-    auto current_head = As<Cell>(target_object)->GetFirst()->Eval(scope);
-    if (!current_head) {  // empty
-        return true;
-    }
     // iterate list
-    auto it_cell = As<Cell>(current_head);
+    auto it_cell = As<Cell>(target_object);
     while (Is<Cell>(it_cell->GetSecond())) {
         it_cell = As<Cell>(it_cell->GetSecond());
     }
@@ -183,244 +341,315 @@ bool IsList::IsTypeOf(Object* target_object, Scope* scope) {
     return true;
 }
 
-Object* Not::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head) || As<Cell>(head)->GetSecond()) {
+Object* Not::Call(std::span<Object*> args) {
+    if (args.size() != 1) {
         throw RuntimeError{"Incorrect args"};
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope);
-    if (args.size() > 1) {
-        throw RuntimeError{"Incorrect args"};
-    }
-    if (!Is<Bool>(args[0])) {
-        return Heap::Instance().Make<Bool>(false);
-    }
-    return Heap::Instance().Make<Bool>(!As<Bool>(args[0])->GetState());
+    return Call1(args[0]);
 }
 
-Object* Abs::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
-        throw RuntimeError{"Incorrect args"};
+Object* Not::Call1(Object* arg) {
+    if (!Is<Bool>(arg)) {
+        return Bool::Get(false);
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope);
-    if (args.size() > 1) {
+    return Bool::Get(!As<Bool>(arg)->GetState());
+}
+
+Object* Abs::Call(std::span<Object*> args) {
+    if (args.size() != 1) {
         throw RuntimeError{"Incorrect args"};
     }
-    if (!Is<Number>(args[0])) {
+    return Call1(args[0]);
+}
+
+Object* Abs::Call1(Object* arg) {
+    if (!IsNumeric(arg)) {
         throw RuntimeError{"Incorrect args"};
     }
-    return Heap::Instance().Make<Number>(std::abs(As<Number>(args[0])->GetValue()));
+    return MakeNumber(heap_, std::abs(GetNumeric(arg)));
 }
 
 // Pair operations
 // Make Pair
-Object* Cons::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
-        throw RuntimeError{"Incorrect args"};
-    }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
+Object* Cons::Call(std::span<Object*> args) {
     if (args.size() != 2) {
         throw RuntimeError{"cons requires 2 arguments"};
     }
-    return Heap::Instance().Make<Cell>(args[0]->Eval(scope), args[1]->Eval(scope));
+    return Call2(args[0], args[1]);
 }
 
-Object* Car::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
+Object* Cons::Call2(Object* lhs, Object* rhs) {
+    return heap_->Make<Cell>(lhs, rhs);
+}
+
+Object* Car::Call(std::span<Object*> args) {
+    if (args.empty()) {
         throw RuntimeError{"Incorrect args"};
     }
-    head = As<Cell>(head)->GetFirst()->Eval(scope);
+    return Call1(args[0]);
+}
+
+Object* Car::Call1(Object* head) {
     if (!head) {
         throw RuntimeError{"car requires non-zero arguments"};
     }
     if (!Is<Cell>(head)) {
         return head;
     }
-    // unpacking
-    if (!As<Cell>(head)) {
-        return As<Cell>(head->Eval(scope))->GetFirst();
-    }
     return As<Cell>(head)->GetFirst();
 }
 
-Object* Cdr::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
+Object* Cdr::Call(std::span<Object*> args) {
+    if (args.empty()) {
         throw RuntimeError{"Incorrect args"};
     }
-    head = As<Cell>(head)->GetFirst()->Eval(scope);
+    return Call1(args[0]);
+}
+
+Object* Cdr::Call1(Object* head) {
     if (!head) {
         throw RuntimeError{"cdr requires non-zero arguments"};
     }
     if (!Is<Cell>(head)) {
         return nullptr;
     }
-    // unpacking
-    if (!As<Cell>(head)) {
-        return As<Cell>(head->Eval(scope))->GetSecond();
-    }
     return As<Cell>(head)->GetSecond();
 }
 
 // List operations
 
-Object* List::Apply(Object* head, Scope* scope) {
-    if (!head) {
+Object* List::Call(std::span<Object*> args) {
+    if (args.empty()) {
         return nullptr;
     }
-    if (!Is<Cell>(head)) {
-        throw RuntimeError{"Incorrect args"};
-    }
-    std::vector<Object*> args = GetVectorFromCell(head, scope);
     // packing
-    auto list = Heap::Instance().Make<Cell>(args.back(), nullptr);
+    auto list = heap_->Make<Cell>(args.back(), nullptr);
     for (ssize_t i = args.size() - 2; i >= 0; --i) {
-        list = Heap::Instance().Make<Cell>(args[i], list);
+        list = heap_->Make<Cell>(args[i], list);
     }
     return list;
 }
 
-Object* ListRef::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
+Object* ListRef::Call(std::span<Object*> args) {
+    if (args.size() != 2) {
         throw RuntimeError{"list-ref expected 2 args"};
     }
-    auto first_arg = As<Cell>(head)->GetFirst()->Eval(scope);
-    std::vector<Object*> target_list = GetVectorFromCell(first_arg, scope);
-    auto second_arg = As<Cell>(As<Cell>(head)->GetSecond())->GetFirst();
-    if (!Is<Number>(second_arg)) {
+    if (!Is<Cell>(args[0])) {
+        throw RuntimeError{"Incorrect args type!"};
+    }
+    if (!IsNumeric(args[1])) {
         throw RuntimeError{"list-ref expected Number type operand as second arg"};
     }
-    if (As<Number>(second_arg)->GetValue() < 0) {
+    if (GetNumeric(args[1]) < 0) {
         throw RuntimeError{""};
     }
-    size_t target_index = static_cast<size_t>(As<Number>(second_arg)->GetValue());
-    if (target_index >= target_list.size()) {
+    size_t target_index = static_cast<size_t>(GetNumeric(args[1]));
+    Object* list = args[0];
+    for (; target_index && Is<Cell>(list); --target_index) {
+        list = As<Cell>(list)->GetSecond();
+    }
+    if (Is<Cell>(list)) {
+        return As<Cell>(list)->GetFirst();
+    }
+    if (!list || target_index) {
         throw RuntimeError{"in list-ref index out of range"};
     }
-    return target_list[target_index];
+    return list;  // the tail of an improper list is its last element
 }
 
-Object* ListTail::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head)) {
-        throw RuntimeError{"list-ref expected 2 args"};
+Object* ListTail::Call(std::span<Object*> args) {
+    if (args.size() != 2) {
+        throw RuntimeError{"list-tail expected 2 args"};
     }
-    auto first_arg = As<Cell>(head)->GetFirst()->Eval(scope);
-    std::vector<Object*> target_list = GetVectorFromCell(first_arg, scope);
-    auto second_arg = As<Cell>(As<Cell>(head)->GetSecond())->GetFirst();
-    if (!Is<Number>(second_arg)) {
-        throw RuntimeError{"list-ref expected Number type operand as second arg"};
+    if (!Is<Cell>(args[0])) {
+        throw RuntimeError{"Incorrect args type!"};
+    }
+    if (!IsNumeric(args[1])) {
+        throw RuntimeError{"list-tail expected Number type operand as second arg"};
     }
-    if (As<Number>(second_arg)->GetValue() < 0) {
+    if (GetNumeric(args[1]) < 0) {
         throw RuntimeError{""};
     }
-    size_t target_index = static_cast<size_t>(As<Number>(second_arg)->GetValue());
-    if (target_index > target_list.size()) {
-        throw RuntimeError{"in list-ref index out of range"};
+    size_t target_index = static_cast<size_t>(GetNumeric(args[1]));
+    Object* list = args[0];
+    for (; target_index && Is<Cell>(list); --target_index) {
+        list = As<Cell>(list)->GetSecond();
     }
-    if (target_index == target_list.size()) {
-        return nullptr;
+    // The sublist is a proper copy, the tail of an improper list becomes its last element
+    size_t rest_count = CountParts(list);
+    if (target_index > rest_count) {
+        throw RuntimeError{"in list-tail index out of range"};
     }
-    auto new_sublist = Heap::Instance().Make<Cell>(target_list.back(), nullptr);
-    for (ssize_t i = target_list.size() - 2; i >= static_cast<ssize_t>(target_index); --i) {
-        new_sublist = Heap::Instance().Make<Cell>(target_list[i], new_sublist);
+    if (target_index == rest_count) {
+        return nullptr;
     }
+    Cell* new_sublist = nullptr;
+    Cell* last = nullptr;
+    ForEachPart(list, [this, &new_sublist, &last](Object* part) {
+        Cell* cell = heap_->Make<Cell>(part, nullptr);
+        if (last) {
+            last->SetTail(cell);
+            heap_->WriteBarrier(last, cell);
+        } else {
+            new_sublist = cell;
+        }
+        last = cell;
+    });
     return new_sublist;
 }
 
-bool Scope::Find(const std::string target_name) const noexcept {
-    auto namespace_it = namespace_.find(target_name);
-    if (namespace_it != namespace_.end()) {
-        return true;
+Symbol* SymbolTable::Intern(std::string_view name) {
+    std::lock_guard lock{mutex_};
+    auto index_it = index_.find(name);
+    if (index_it != index_.end()) {
+        return index_it->second;
+    }
+    Symbol* symbol = &symbols_.emplace_back(name, static_cast<SymbolId>(symbols_.size()));
+    index_.emplace(symbol->GetName(), symbol);
+    return symbol;
+}
+
+Scope::Scope(Heap* heap, Namespace&& a_namespace)
+        : Object(kType),
+          heap_(heap),
+          global_scope_(this),
+          namespace_(std::move(a_namespace)),
+          global_bindings_(std::make_unique<GlobalBindings>()) {
+    for (auto& [name, value] : namespace_) {
+        CacheSlot(name, &value);
+    }
+}
+
+void Scope::Define(SymbolId target_name, Object* value) {
+    Object*& slot = namespace_[target_name];
+    heap_->PreWriteBarrier(slot);
+    slot = value;
+    if (global_scope_ == this) {
+        CacheSlot(target_name, &slot);
+    } else {
+        // Cached global slot of the name is no longer right for lookups from here
+        std::vector<bool>& is_shadowed = global_scope_->global_bindings_->is_shadowed;
+        if (target_name >= is_shadowed.size()) {
+            is_shadowed.resize(std::max<size_t>(target_name + 1, 2 * is_shadowed.size()));
+        }
+        is_shadowed[target_name] = true;
     }
-    if (parent_scope_ != nullptr) {
-        return parent_scope_->Find(target_name);
+    heap_->WriteBarrier(this, value);
+}
+
+void Scope::CacheSlot(SymbolId name, Object** slot) {
+    std::vector<Object**>& slots = global_bindings_->slots;
+    if (name >= slots.size()) {
+        slots.resize(std::max<size_t>(name + 1, 2 * slots.size()));
     }
-    return false;
+    slots[name] = slot;
+}
+
+Object** Scope::Lookup(SymbolId target_name, Scope** owner) noexcept {
+    GlobalBindings& global_bindings = *global_scope_->global_bindings_;
+    const std::vector<bool>& is_shadowed = global_bindings.is_shadowed;
+    if (target_name >= is_shadowed.size() || !is_shadowed[target_name]) {
+        const std::vector<Object**>& slots = global_bindings.slots;
+        Object** slot = target_name < slots.size() ? slots[target_name] : nullptr;
+        if (slot) {
+            ++global_bindings.stats.hits;
+            if (owner) {
+                *owner = global_scope_;
+            }
+        }
+        return slot;
+    }
+    for (Scope* scope = this; scope; scope = scope->parent_scope_) {
+        auto namespace_it = scope->namespace_.find(target_name);
+        if (namespace_it != scope->namespace_.end()) {
+            if (scope == global_scope_) {
+                ++global_bindings.stats.misses;
+            }
+            if (owner) {
+                *owner = scope;
+            }
+            return &namespace_it->second;
+        }
+    }
+    return nullptr;
 }
 
-Object*& Scope::Get(const std::string target_name) {
-    auto namespace_it = namespace_.find(target_name);
-    if (namespace_it != namespace_.end()) {
-        return namespace_it->second;
+void Scope::Trace(std::vector<Object*>* references) {
+    references->push_back(parent_scope_);
+    for (auto& [name, value] : namespace_) {
+        references->push_back(value);
     }
-    if (parent_scope_ != nullptr) {
-        return parent_scope_->Get(target_name);
+}
+
+void Scope::TraceSlots(std::vector<Object**>* slots) {
+    for (auto& [name, value] : namespace_) {
+        slots->push_back(&value);
     }
-    namespace_[target_name] = Heap::Instance().Make<Object>();
-    return namespace_[target_name];
 }
 
 Object* If::Apply(Object* head, Scope* scope) {
+    return ApplyByTail(head, scope);
+}
+
+Object* If::ApplyTail(Object* head, Scope** scope, bool* is_tail_call) {
+    *is_tail_call = false;
     if (!head || !Is<Cell>(head)) {
         throw SyntaxError{"if expected 1 or 2 arguments and maybe return value as 3 argument"};
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
-    if (args.size() == 1) {
-        return Heap::Instance().Make<Cell>(nullptr, nullptr);
+    Object* args[3];
+    size_t args_count = GetParts(head, args);
+    if (args_count == 1) {
+        return (*scope)->GetHeap()->Make<Cell>(nullptr, nullptr);
     }
-    if (args.size() > 3) {
+    if (args_count > 3) {
         throw SyntaxError{"if expected 1 or 2 arguments and maybe return value as 3 argument"};
     }
-    auto eval_cond = args[0]->Eval(scope);
+    auto eval_cond = args[0]->Eval(*scope);
     bool condition_flag = !Is<Bool>(eval_cond) || As<Bool>(eval_cond)->GetState();
     if (condition_flag) {
-        if (args.size() > 1) {
-            return args[1]->Eval(scope);  // true branch
-        }
-    } else {
-        if (args.size() > 2) {
-            return args[2]->Eval(scope);  // false branch
-        }
-        return nullptr;
+        *is_tail_call = true;
+        return args[1];  // true branch
+    }
+    if (args_count > 2) {
+        *is_tail_call = true;
+        return args[2];  // false branch
     }
-    return Heap::Instance().Make<Cell>(nullptr, nullptr);
+    return nullptr;
 }
 
 Object* Define::Apply(Object* head, Scope* scope) {
     if (!head || !Is<Cell>(head) || !As<Cell>(head)->GetSecond()) {
         throw SyntaxError{"Invalid args Define 1"};
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
-    if (args.size() < 2) {
+    Object* args[2];
+    size_t args_count = GetParts(head, args);
+    if (args_count < 2) {
         throw SyntaxError{"Invalid args Define 2"};
     }
     if (!Is<Cell>(args[0])) {  // if it variable
-        if (args.size() != 2) {
+        if (args_count != 2) {
             throw SyntaxError{"Invalid args in Define"};
         }
         if (!Is<Symbol>(args[0])) {
             throw SyntaxError{"Invalid args Define 3"};
         }
-        std::string variable_name = As<Symbol>(args[0])->GetName();
+        SymbolId variable_name = As<Symbol>(args[0])->GetId();
         if (!args[1]) {
             throw SyntaxError{"Invalid args Define 4"};
         }
         Object* variable_value = args[1]->Eval(scope);
         scope->Define(variable_name, variable_value);
     } else {  // if it lambda
-        auto lambda_header = GetVectorFromCell(args[0], scope, false);
-        if (!Is<Symbol>(lambda_header[0])) {
+        Object* lambda_header = args[0];
+        if (!Is<Symbol>(As<Cell>(lambda_header)->GetFirst())) {
             throw SyntaxError{"Invalid args Define 5"};
         }
-        std::string lambda_name = As<Symbol>(lambda_header[0])->GetName();
-
-        // Read lambda args
-        std::vector<std::string> lambda_args;
-        if (lambda_header.size() > 1) {
-            lambda_args.reserve(lambda_header.size() - 1);
-            for (size_t i = 1; i < lambda_header.size(); ++i) {
-                if (!Is<Symbol>(lambda_header[i])) {
-                    throw SyntaxError{"Invalid args Define 6"};
-                }
-                lambda_args.emplace_back(As<Symbol>(lambda_header[i])->GetName());
-            }
-        }
-        // Read lambda body
-        std::vector<Object*> lambda_body;
-        lambda_body.reserve(args.size() - 1);
-        for (size_t i = 1; i < args.size(); ++i) {
-            lambda_body.push_back(args[i]);
-        }
-        // Create lambda
-        scope->Define(lambda_name, Heap::Instance().Make<Lambda>(lambda_args, lambda_body, scope));
+        SymbolId lambda_name = As<Symbol>(As<Cell>(lambda_header)->GetFirst())->GetId();
+        std::vector<SymbolId> lambda_args =
+            GetParams(As<Cell>(lambda_header)->GetSecond(), "Invalid args Define 6");
+        std::vector<Object*> lambda_body = GetBody(As<Cell>(head)->GetSecond());
+        scope->Define(lambda_name, scope->GetHeap()->Make<Lambda>(std::move(lambda_args),
+                                                                   std::move(lambda_body), scope));
     }
     return nullptr;
 }
@@ -429,79 +658,55 @@ Object* Set::Apply(Object* head, Scope* scope) {
     if (!head || !Is<Cell>(head) || !As<Cell>(head)->GetSecond()) {
         throw SyntaxError{"Invalid args Set 1"};
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
-    if (args.size() != 2) {
+    Object* args[2];
+    if (GetParts(head, args) != 2) {
         throw SyntaxError{"Invalid args Set 2"};
     }
     if (!Is<Cell>(args[0])) {  // if it variable
         if (!Is<Symbol>(args[0])) {
             throw SyntaxError{"Invalid args Set 3"};
         }
-        std::string variable_name = As<Symbol>(args[0])->GetName();
-        if (!scope->Find(variable_name)) {
+        Scope* owner = nullptr;
+        Object** variable = scope->Lookup(As<Symbol>(args[0])->GetId(), &owner);
+        if (!variable) {
             throw NameError{"Invalid args Set 4"};
         }
         if (!args[1]) {
             throw SyntaxError{"Invalid args Set 5"};
         }
-        scope->Get(variable_name) = args[1]->Eval(scope);
+        Object* value = args[1]->Eval(scope);
+        owner->GetHeap()->PreWriteBarrier(*variable);
+        *variable = value;
+        owner->GetHeap()->WriteBarrier(owner, value);
     } else {  // if it lambda
         throw SyntaxError{"Invalid args Set 6"};
     }
     return nullptr;
 }
 
-Object* SetCar::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head) || !As<Cell>(head)->GetSecond()) {
-        throw SyntaxError{"Invalid args"};
-    }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
+Object* SetCar::Call(std::span<Object*> args) {
     if (args.size() != 2) {
         throw SyntaxError{"Invalid args"};
     }
-    auto to_assign = args[0]->Eval(scope);
-    if (Is<Symbol>(to_assign)) {
-        std::string variable_name = As<Symbol>(to_assign)->GetName();
-        if (!scope->Find(variable_name)) {
-            throw NameError{"Invalid args"};
-        }
-        to_assign = scope->Get(variable_name);
-    }
-    if (!args[1]) {
-        throw SyntaxError{"Invalid args"};
-    }
-    auto new_head = args[1]->Eval(scope);
-    if (!Is<Cell>(to_assign)) {
+    if (!Is<Cell>(args[0])) {
         throw SyntaxError{"Invalid args"};
     }
-    As<Cell>(to_assign)->SetHead(new_head);
+    heap_->PreWriteBarrier(As<Cell>(args[0])->GetFirst());
+    As<Cell>(args[0])->SetHead(args[1]);
+    heap_->WriteBarrier(args[0], args[1]);
     return nullptr;
 }
 
-Object* SetCdr::Apply(Object* head, Scope* scope) {
-    if (!head || !Is<Cell>(head) || !As<Cell>(head)->GetSecond()) {
-        throw SyntaxError{"Invalid args"};
-    }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
+Object* SetCdr::Call(std::span<Object*> args) {
     if (args.size() != 2) {
         throw SyntaxError{"Invalid args"};
     }
-    auto to_assign = args[0]->Eval(scope);
-    if (Is<Symbol>(to_assign)) {
-        std::string variable_name = As<Symbol>(to_assign)->GetName();
-        if (!scope->Find(variable_name)) {
-            throw NameError{"Invalid args"};
-        }
-        to_assign = scope->Get(variable_name);
-    }
-    if (!args[1]) {
-        throw SyntaxError{"Invalid args"};
-    }
-    auto new_tail = args[1]->Eval(scope);
-    if (!Is<Cell>(to_assign)) {
+    if (!Is<Cell>(args[0])) {
         throw SyntaxError{"Invalid args"};
     }
-    As<Cell>(to_assign)->SetTail(new_tail);
+    heap_->PreWriteBarrier(As<Cell>(args[0])->GetSecond());
+    As<Cell>(args[0])->SetTail(args[1]);
+    heap_->WriteBarrier(args[0], args[1]);
     return nullptr;
 }
 
@@ -509,113 +714,688 @@ Object* MakeLambda::Apply(Object* head, Scope* scope) {
     if (!head || !Is<Cell>(head)) {
         throw SyntaxError{"Invalid args in make Lambda 1"};
     }
-    std::vector<Object*> args = GetVectorFromCell(head, scope, false);
-    if (args.size() < 2) {
+    if (CountParts(head) < 2) {
         throw SyntaxError{"Invalid args in make Lambda 2"};
     }
-    // Gen lambda name
-    //    std::string lambda_name = Lambda::CreateRandomName(15);
-    // Read lambda args
-    std::vector<std::string> lambda_args;
-    if (args[0]) {
-        std::vector<Object*> lambda_args_not_eval = GetVectorFromCell(args[0], scope, false);
-        lambda_args.reserve(lambda_args_not_eval.size());
-        for (size_t i = 0; i < lambda_args_not_eval.size(); ++i) {
-            if (!Is<Symbol>(lambda_args_not_eval[i])) {
-                throw SyntaxError{"Invalid args in make Lambda 3"};
-            }
-            lambda_args.push_back(As<Symbol>(lambda_args_not_eval[i])->GetName());
-        }
-    }
-    // Read lambda body
-    std::vector<Object*> lambda_body;
-    lambda_body.reserve(args.size() - 1);
-    for (size_t i = 1; i < args.size(); ++i) {
-        lambda_body.push_back(args[i]);
+    Object* lambda_header = As<Cell>(head)->GetFirst();
+    if (lambda_header && !Is<Cell>(lambda_header)) {
+        throw RuntimeError{"Incorrect args type!"};
     }
-    // Create lambda
-    return Heap::Instance().Make<Lambda>(lambda_args, lambda_body, scope);
+    std::vector<SymbolId> lambda_args = GetParams(lambda_header, "Invalid args in make Lambda 3");
+    std::vector<Object*> lambda_body = GetBody(As<Cell>(head)->GetSecond());
+    return scope->GetHeap()->Make<Lambda>(std::move(lambda_args), std::move(lambda_body), scope);
 }
 
-Lambda::Lambda(std::vector<std::string> args, std::vector<Object*> body, Scope* parent_scope)
-        : args_(std::move(args)), body_(std::move(body)) {
-    scope_ = Heap::Instance().Make<Scope>(parent_scope);
+Lambda::Lambda(std::vector<SymbolId> args, std::vector<Object*> body, Scope* parent_scope)
+        : Function(kType), args_(std::move(args)), body_(std::move(body)) {
+    scope_ = parent_scope->GetHeap()->Make<Scope>(parent_scope);
     //    lambda_scopes_catalog.emplace_back(scope_);
 }
 
+void Lambda::Trace(std::vector<Object*>* references) {
+    references->push_back(scope_);
+    references->insert(references->end(), body_.begin(), body_.end());
+}
+
+void Lambda::TraceSlots(std::vector<Object**>* slots) {
+    for (Object*& form : body_) {
+        slots->push_back(&form);
+    }
+}
+
 Object* Lambda::Apply(Object* head, Scope* scope) {
-    Scope* local_scope = Heap::Instance().Make<Scope>(scope_);
+    return ApplyByTail(head, scope);
+}
+
+Object* Lambda::ApplyTail(Object* head, Scope** scope, bool* is_tail_call) {
+    Scope* local_scope = scope_->GetHeap()->Make<Scope>(scope_);
     //    lambda_scopes_catalog.emplace_back(local_scope);
+    Object* roots[] = {local_scope};
+    EvalRootsGuard roots_guard{scope_->GetHeap(), roots};
     if (head && Is<Cell>(head)) {
-        std::vector<Object*> args = GetVectorFromCell(head, scope, false);
-        if (args.size() != args_.size()) {
+        if (CountParts(head) != args_.size()) {
             throw RuntimeError{"Invalid args in lambda apply"};
         }
         // Init current local scope
-        for (size_t i = 0; i < args.size(); ++i) {
-            local_scope->Define(args_[i], args[i]->Eval(scope));
-        }
+        size_t index = 0;
+        ForEachPart(head, [this, scope, local_scope, &index](Object* arg) {
+            if (!arg) {
+                throw RuntimeError{"Incorrect args type"};
+            }
+            local_scope->Define(args_[index++], arg->Eval(*scope));
+        });
     } else {
         if (!args_.empty()) {
             throw RuntimeError{"Invalid args in lambda apply"};
         }
     }
-    Object* result = nullptr;
-    for (auto ptr_to_command : body_) {
-        result = ptr_to_command->Eval(local_scope);
+    for (size_t i = 0; i + 1 < body_.size(); ++i) {
+        body_[i]->Eval(local_scope);
     }
-    return result;
+    // Last form is evaluated by the caller, so the C++ stack doesn't grow in tail calls
+    *scope = local_scope;
+    *is_tail_call = true;
+    return body_.back();
 }
 
-void Heap::Destroy(Object* ptr) {
-    auto to_destroy_it = objects_tree_.find(ptr);
-    if (to_destroy_it != objects_tree_.end()) {
-        delete ptr;
-        objects_tree_.erase(to_destroy_it);
+Heap::~Heap() {
+    StopMarker();
+    arena_.ForEachSlot([](void* slot) { static_cast<Object*>(slot)->~Object(); });
+}
+
+void Heap::Collect(std::span<Object* const> roots, bool full) {
+    if (IsCollecting() && !full) {
+        Step();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (IsCollecting()) {
+        FinishCycle();
+    }
+    collector_stats_.peak_size = std::max(collector_stats_.peak_size, Size());
+    bool is_major = full || old_count_ > major_threshold_;
+    if (is_major && !full && is_incremental_) {
+        StartCycle(roots);
+        RecordPause(start);
+        return;
     }
+    NextEpoch();
+    mark_stack_.assign(roots.begin(), roots.end());
+    if (is_major && collector_threads_ > 1) {
+        MarkInParallel();
+        SweepInParallel();
+        major_threshold_ = std::max(kMinMajorThreshold, 2 * old_count_);
+    } else if (is_major) {
+        MarkingObjects(false);
+        Sweep();
+        major_threshold_ = std::max(kMinMajorThreshold, 2 * old_count_);
+    } else {
+        // Young objects are reachable from the roots or from the old objects written by
+        // the barrier
+        for (Object* remembered : remembered_set_) {
+            remembered->Trace(&mark_stack_);
+        }
+        MarkingObjects(true);
+        SweepNursery();
+    }
+    SetCollectionBudget(growth_factor_, min_collection_budget_);
+    ++collector_stats_.collections;
+    RecordPause(start);
 }
 
-void Heap::Sweep(std::unordered_set<Object*>& marks) {
-    for (auto ptr : objects_tree_) {
-        if (marks.find(ptr) == marks.end()) {
-            Destroy(ptr);
+void Heap::StepCycle(bool may_finish) {
+    if (!IsCollecting() || (phase_ == Phase::SWEPT && !may_finish)) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    allocations_since_step_ = 0;
+    if (phase_ == Phase::MARKING) {
+        bool is_marked = marker_.joinable()
+                             ? DrainConcurrentMarking(step_objects_)
+                             : MarkingObjects(false, step_objects_, start + step_time_);
+        if (is_marked) {
+            StopMarker();
+            phase_ = Phase::SWEEPING;
+            arena_.BeginSweep();
+        }
+    } else {
+        SweepStep(step_objects_, may_finish);
+    }
+    RecordPause(start);
+}
+
+void Heap::StartCycle(std::span<Object* const> roots) {
+    NextEpoch();
+    // Young objects are a part of the snapshot and are swept as old ones
+    for (Object* object : nursery_) {
+        object->generation_ = Generation::OLD;
+    }
+    for (Object* object : survivors_) {
+        object->generation_ = Generation::OLD;
+    }
+    old_count_ += nursery_.size() + survivors_.size();
+    nursery_.clear();
+    survivors_.clear();
+    remembered_set_.clear();
+    mark_stack_.assign(roots.begin(), roots.end());
+    phase_ = Phase::MARKING;
+    allocations_since_step_ = 0;
+    ++collector_stats_.cycles;
+    if (is_concurrent_) {
+        is_marker_stopped_ = false;
+        marker_ = std::thread{&Heap::MarkConcurrently, this};
+        DrainConcurrentMarking(step_objects_);
+    }
+}
+
+void Heap::FinishCycle() {
+    if (phase_ == Phase::MARKING) {
+        if (marker_.joinable()) {
+            while (!DrainConcurrentMarking(SIZE_MAX)) {
+                std::unique_lock lock{marker_mutex_};
+                mutator_cv_.wait(lock, [this] {
+                    return (!is_marker_busy_ && marker_work_.empty()) || !mutator_work_.empty();
+                });
+            }
+            StopMarker();
+        } else {
+            MarkingObjects(false);
+        }
+        phase_ = Phase::SWEEPING;
+        arena_.BeginSweep();
+    }
+    SweepStep(SIZE_MAX);
+}
+
+void Heap::MarkConcurrently() {
+    std::vector<Object*> stack;
+    std::vector<Object*> deferred;
+    std::unique_lock lock{marker_mutex_};
+    while (true) {
+        marker_cv_.wait(lock, [this] { return is_marker_stopped_ || !marker_work_.empty(); });
+        if (is_marker_stopped_) {
+            return;
+        }
+        stack.swap(marker_work_);
+        is_marker_busy_ = true;
+        lock.unlock();
+        size_t marked_count = 0;
+        while (!stack.empty()) {
+            // A full collection or the destructor may stop the cycle in the middle
+            if (++marked_count % 4096 == 0 && is_marker_stopped_) {
+                break;
+            }
+            Object* object = stack.back();
+            stack.pop_back();
+            if (!IsTraced(object) || LoadMark(object) == epoch_) {
+                continue;
+            }
+            if (object->type_ == ObjectType::CELL) {
+                StoreMark(object);
+                static_cast<Cell*>(object)->TraceAcquire(&stack);
+            } else if (object->type_ == ObjectType::NUMBER) {
+                StoreMark(object);
+            } else {
+                deferred.push_back(object);
+            }
+        }
+        stack.clear();
+        lock.lock();
+        mutator_work_.insert(mutator_work_.end(), deferred.begin(), deferred.end());
+        deferred.clear();
+        is_marker_busy_ = false;
+        mutator_cv_.notify_one();
+    }
+}
+
+bool Heap::DrainConcurrentMarking(size_t budget) {
+    {
+        std::lock_guard lock{marker_mutex_};
+        mark_stack_.insert(mark_stack_.end(), mutator_work_.begin(), mutator_work_.end());
+        mutator_work_.clear();
+    }
+    references_.clear();
+    size_t traced_count = 0;
+    while (!mark_stack_.empty() && traced_count < budget) {
+        Object* object = mark_stack_.back();
+        mark_stack_.pop_back();
+        if (!IsTraced(object)) {
+            continue;
         }
+        if (object->type_ == ObjectType::CELL || object->type_ == ObjectType::NUMBER) {
+            references_.push_back(object);
+        } else if (LoadMark(object) != epoch_) {
+            StoreMark(object);
+            object->Trace(&mark_stack_);
+            ++traced_count;
+        }
+    }
+    std::lock_guard lock{marker_mutex_};
+    if (!references_.empty()) {
+        marker_work_.insert(marker_work_.end(), references_.begin(), references_.end());
+        marker_cv_.notify_one();
+        return false;
     }
+    return mark_stack_.empty() && mutator_work_.empty() && marker_work_.empty() &&
+           !is_marker_busy_;
 }
 
-void Heap::MarkingObjects(Object* current_object, std::unordered_set<Object*>& marks) {
-    if (!current_object) {
+void Heap::StopMarker() {
+    if (!marker_.joinable()) {
         return;
     }
-    std::vector<Object*> not_visited_children;
-    marks.insert(current_object);
-    if (Is<Cell>(current_object)) {
-        auto cell_ptr = As<Cell>(current_object);
-        not_visited_children.push_back(cell_ptr->GetFirst());
-        not_visited_children.push_back(cell_ptr->GetSecond());
-    } else if (Is<Lambda>(current_object)) {
-        auto lambda_ptr = As<Lambda>(current_object);
-        for (Object* to : lambda_ptr->GetBody()) {
-            not_visited_children.push_back(to);
+    {
+        std::lock_guard lock{marker_mutex_};
+        is_marker_stopped_ = true;
+        marker_work_.clear();
+        mutator_work_.clear();
+    }
+    marker_cv_.notify_one();
+    marker_.join();
+}
+
+void Heap::SweepStep(size_t budget, bool may_finish) {
+    // Objects allocated during the cycle are black, so the unmarked ones are old garbage
+    bool is_done = arena_.SweepSlabs(budget, [this](void* slot) {
+        auto object = static_cast<Object*>(slot);
+        if (!IsMarked(object)) {
+            Destroy(object);
+            --old_count_;
         }
-        not_visited_children.push_back(lambda_ptr->GetScope());
-    } else if (Is<Scope>(current_object)) {
-        auto scope_ptr = As<Scope>(current_object);
-        for (auto& [name, ptr] : scope_ptr->GetNamespace()) {
-            not_visited_children.push_back(ptr);
+    });
+    if (is_done && !may_finish) {
+        phase_ = Phase::SWEPT;
+    } else if (is_done) {
+        phase_ = Phase::IDLE;
+        major_threshold_ = std::max(kMinMajorThreshold, 2 * old_count_);
+        SetCollectionBudget(growth_factor_, min_collection_budget_);
+        ++collector_stats_.collections;
+    }
+}
+
+void Heap::RecordPause(std::chrono::steady_clock::time_point start) noexcept {
+    auto pause = std::chrono::steady_clock::now() - start;
+    collector_stats_.time += pause;
+    ++collector_stats_.pauses;
+    collector_stats_.max_pause = std::max<std::chrono::nanoseconds>(collector_stats_.max_pause,
+                                                                    pause);
+    auto& histogram = collector_stats_.pause_histogram;
+    auto microseconds = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(pause).count());
+    ++histogram[std::min<size_t>(std::bit_width(microseconds), histogram.size() - 1)];
+}
+
+std::chrono::microseconds CollectorStats::GetPausePercentile(double fraction) const noexcept {
+    auto count = static_cast<size_t>(std::ceil(fraction * static_cast<double>(pauses)));
+    size_t seen = 0;
+    for (size_t i = 0; i < pause_histogram.size(); ++i) {
+        seen += pause_histogram[i];
+        if (seen >= count) {
+            return std::chrono::microseconds{uint64_t{1} << i};
         }
-        not_visited_children.push_back(scope_ptr->GetParentScope());
     }
-    for (auto to : not_visited_children) {
-        if (to && marks.find(to) == marks.end()) {
-            MarkingObjects(to, marks);
+    return std::chrono::microseconds{uint64_t{1} << pause_histogram.size()};
+}
+
+void Heap::SetCollectionBudget(double growth_factor, size_t min_budget) noexcept {
+    growth_factor_ = std::max(growth_factor, 1.0);
+    min_collection_budget_ = min_budget;
+    auto grown_size = static_cast<size_t>(static_cast<double>(Size()) * growth_factor_);
+    next_collection_size_ = std::max(grown_size, Size() + min_budget);
+}
+
+void Heap::NextEpoch() {
+    if (++epoch_ == 0) {
+        // Stale epochs of the heap objects could match again after the overflow
+        arena_.ForEachSlot([](void* slot) { static_cast<Object*>(slot)->mark_epoch_ = 0; });
+        epoch_ = 1;
+    }
+}
+
+bool Heap::MarkingObjects(bool young_only, size_t budget,
+                          std::chrono::steady_clock::time_point deadline) {
+    // Objects are prefetched when they leave the mark stack and marked kPrefetchDistance
+    // steps later, when their headers are already in the cache
+    std::array<Object*, kPrefetchDistance> queue;
+    size_t queue_begin = 0;
+    size_t queue_size = 0;
+    size_t marked_count = 0;
+    while (queue_size || !mark_stack_.empty()) {
+        while (queue_size < kPrefetchDistance && !mark_stack_.empty()) {
+            Object* object = mark_stack_.back();
+            mark_stack_.pop_back();
+            if (IsTraced(object)) {
+                __builtin_prefetch(object, 1);
+                queue[(queue_begin + queue_size++) % kPrefetchDistance] = object;
+            }
+        }
+        if (!queue_size) {
+            break;
+        }
+        Object* current_object = queue[queue_begin];
+        queue_begin = (queue_begin + 1) % kPrefetchDistance;
+        --queue_size;
+        if (IsMarked(current_object) || (young_only && !IsYoung(current_object))) {
+            continue;
+        }
+        current_object->mark_epoch_ = epoch_;
+        // Cells are most of the heap and numbers are leaves, they skip the virtual Trace
+        switch (current_object->type_) {
+            case ObjectType::CELL:
+                static_cast<Cell*>(current_object)->Trace(&mark_stack_);
+                break;
+            case ObjectType::NUMBER:
+                break;
+            default:
+                current_object->Trace(&mark_stack_);
+        }
+        // The clock is read once in a while, it costs more than marking an object
+        if (++marked_count == budget ||
+            (marked_count % 256 == 0 && std::chrono::steady_clock::now() >= deadline)) {
+            for (; queue_size; --queue_size, queue_begin = (queue_begin + 1) % kPrefetchDistance) {
+                mark_stack_.push_back(queue[queue_begin]);
+            }
+            return mark_stack_.empty();
+        }
+    }
+    return true;
+}
+
+struct Heap::MarkWorker {
+    // Taken from the back by the owner only
+    std::vector<Object*> local;
+    std::mutex mutex;
+    std::vector<Object*> shared;
+    // Idle threads look for work without the lock
+    std::atomic<size_t> shared_size = 0;
+};
+
+namespace {
+
+// Runs work(index) on threads_count threads, the calling thread is the first one
+template <class Work>
+void RunOnThreads(size_t threads_count, Work&& work) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threads_count; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+void Heap::MarkInParallel() {
+    std::vector<MarkWorker> workers(collector_threads_);
+    for (size_t i = 0; i < mark_stack_.size(); ++i) {
+        workers[i % workers.size()].local.push_back(mark_stack_[i]);
+    }
+    mark_stack_.clear();
+    std::atomic<size_t> idle_count = 0;
+    RunOnThreads(workers.size(),
+                 [this, &workers, &idle_count](size_t index) {
+                     RunMarkWorker(workers, index, &idle_count);
+                 });
+}
+
+void Heap::RunMarkWorker(std::span<MarkWorker> workers, size_t index,
+                         std::atomic<size_t>* idle_count) {
+    MarkWorker& worker = workers[index];
+    std::vector<Object*>& local = worker.local;
+    while (true) {
+        while (!local.empty()) {
+            Object* object = local.back();
+            local.pop_back();
+            if (!IsTraced(object) ||
+                std::atomic_ref{object->mark_epoch_}.exchange(epoch_, std::memory_order_relaxed) ==
+                    epoch_) {
+                continue;
+            }
+            switch (object->type_) {
+                case ObjectType::CELL:
+                    static_cast<Cell*>(object)->Trace(&local);
+                    break;
+                case ObjectType::NUMBER:
+                    break;
+                default:
+                    object->Trace(&local);
+            }
+            if (local.size() > kMarkShareThreshold &&
+                !worker.shared_size.load(std::memory_order_relaxed)) {
+                std::lock_guard lock{worker.mutex};
+                auto half = local.begin() + static_cast<ptrdiff_t>(local.size() / 2);
+                worker.shared.assign(local.begin(), half);
+                local.erase(local.begin(), half);
+                worker.shared_size = worker.shared.size();
+            }
+        }
+        if (StealMarkWork(workers, index)) {
+            continue;
+        }
+        // Only busy threads share objects, so all of them idle means the marking is done
+        ++*idle_count;
+        while (*idle_count != workers.size()) {
+            if (std::any_of(workers.begin(), workers.end(),
+                            [](const MarkWorker& other) { return other.shared_size != 0; })) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if (*idle_count == workers.size()) {
+            return;
+        }
+        --*idle_count;
+    }
+}
+
+bool Heap::StealMarkWork(std::span<MarkWorker> workers, size_t index) {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        MarkWorker& victim = workers[(index + i) % workers.size()];
+        if (!victim.shared_size) {
+            continue;
+        }
+        std::lock_guard lock{victim.mutex};
+        // The own objects are taken at once, half of the others' ones
+        size_t count = i ? (victim.shared.size() + 1) / 2 : victim.shared.size();
+        if (!count) {
+            continue;
+        }
+        std::vector<Object*>& local = workers[index].local;
+        local.insert(local.end(), victim.shared.end() - static_cast<ptrdiff_t>(count),
+                     victim.shared.end());
+        victim.shared.resize(victim.shared.size() - count);
+        victim.shared_size = victim.shared.size();
+        return true;
+    }
+    return false;
+}
+
+void Heap::SweepInParallel() {
+    const size_t chunks_count = arena_.BeginParallelSweep();
+    std::atomic<size_t> next_chunk = 0;
+    std::atomic<size_t> old_count = 0;
+    RunOnThreads(collector_threads_, [this, chunks_count, &next_chunk, &old_count](size_t) {
+        size_t marked_count = 0;
+        for (size_t chunk; (chunk = next_chunk.fetch_add(1)) < chunks_count;) {
+            arena_.SweepChunk(chunk, [this, &marked_count](void* slot) {
+                auto object = static_cast<Object*>(slot);
+                if (IsMarked(object)) {
+                    object->generation_ = Generation::OLD;
+                    ++marked_count;
+                } else {
+                    object->~Object();
+                    Arena::ReleaseInSweep(slot);
+                }
+            });
+        }
+        old_count += marked_count;
+    });
+    old_count_ = old_count;
+    nursery_.clear();
+    survivors_.clear();
+    remembered_set_.clear();
+    arena_.ReleaseEmptySlabs();
+}
+
+void Heap::CompactCells(std::span<Object** const> root_slots) {
+    std::vector<Object*> roots;
+    for (Object** slot : root_slots) {
+        roots.push_back(*slot);
+    }
+    // Everything left is old and marked
+    Collect(roots, true);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Cell*> copies;
+    for (Object** slot : root_slots) {
+        ForwardSlot(slot, &copies);
+    }
+    // Slots are gathered first, copies are allocated in the slabs which are walked
+    std::vector<Object**> slots;
+    arena_.ForEachSlot([&slots](void* slot) {
+        auto object = static_cast<Object*>(slot);
+        if (object->type_ != ObjectType::CELL) {
+            object->TraceSlots(&slots);
+        }
+    });
+    for (Object** slot : slots) {
+        ForwardSlot(slot, &copies);
+    }
+    // Cheney scan, the copies are the queue
+    for (size_t i = 0; i < copies.size(); ++i) {
+        slots.clear();
+        copies[i]->TraceSlots(&slots);
+        for (Object** slot : slots) {
+            ForwardSlot(slot, &copies);
+        }
+    }
+    for (Cell* copy : copies) {
+        copy->generation_ = Generation::OLD;
+    }
+    arena_.ForEachSlot([this](void* slot) {
+        auto object = static_cast<Object*>(slot);
+        if (!IsMarked(object)) {
+            Destroy(object);
+        }
+    });
+    arena_.ReleaseEmptySlabs();
+    RecordPause(start);
+}
+
+Cell* Heap::CopyCell(Cell* cell, std::vector<Cell*>* copies) {
+    auto copy = new (arena_.AllocateFresh(sizeof(Cell))) Cell(cell->GetFirst(), cell->GetSecond());
+    copy->generation_ = Generation::SURVIVOR;
+    copy->mark_epoch_ = epoch_;
+    cell->SetHead(copy);
+    cell->mark_epoch_ = 0;
+    copies->push_back(copy);
+    return copy;
+}
+
+void Heap::ForwardSlot(Object** slot, std::vector<Cell*>* copies) {
+    Object* object = *slot;
+    if (!IsTraced(object) || object->type_ != ObjectType::CELL ||
+        object->generation_ == Generation::SURVIVOR) {
+        return;
+    }
+    auto cell = static_cast<Cell*>(object);
+    if (!IsMarked(cell)) {
+        *slot = cell->GetFirst();
+        return;
+    }
+    Cell* copy = CopyCell(cell, copies);
+    *slot = copy;
+    // The spine is copied at once, so the cells of a list are adjacent
+    for (Cell* last = copy;;) {
+        Object* tail = last->GetSecond();
+        if (!IsTraced(tail) || tail->type_ != ObjectType::CELL || !IsMarked(tail) ||
+            tail->generation_ == Generation::SURVIVOR) {
+            break;
+        }
+        Cell* tail_copy = CopyCell(static_cast<Cell*>(tail), copies);
+        last->SetTail(tail_copy);
+        last = tail_copy;
+    }
+}
+
+void Heap::Sweep() {
+    old_count_ = 0;
+    arena_.ForEachSlot([this](void* slot) {
+        auto object = static_cast<Object*>(slot);
+        if (IsMarked(object)) {
+            object->generation_ = Generation::OLD;
+            ++old_count_;
+        } else {
+            Destroy(object);
+        }
+    });
+    nursery_.clear();
+    survivors_.clear();
+    remembered_set_.clear();
+    arena_.ReleaseEmptySlabs();
+}
+
+void Heap::SweepNursery() {
+    for (Object* object : survivors_) {
+        if (!IsMarked(object)) {
+            Destroy(object);
+            continue;
+        }
+        object->generation_ = Generation::OLD;
+        ++old_count_;
+        // Marked nursery objects become survivors, so the promoted object points to young ones
+        references_.clear();
+        object->Trace(&references_);
+        if (std::any_of(references_.begin(), references_.end(), [](Object* to) {
+                return IsReference(to) && to->generation_ == Generation::NURSERY;
+            })) {
+            remembered_set_.insert(object);
+        }
+    }
+    survivors_.clear();
+    for (Object* object : nursery_) {
+        if (IsMarked(object)) {
+            object->generation_ = Generation::SURVIVOR;
+            survivors_.push_back(object);
+        } else {
+            Destroy(object);
         }
     }
+    nursery_.clear();
+}
+
+Object* Heap::Promote(Object* object) {
+    if (!IsSyntax(object)) {
+        return object;
+    }
+    if (!Is<Cell>(object)) {
+        return MakeNumber(this, As<Number>(object)->GetValue());
+    }
+    // Copies of cells are linked while the cells are visited, so deep syntax doesn't recurse
+    Cell* root = Make<Cell>();
+    std::vector<std::pair<Cell*, Cell*>> pending{{As<Cell>(object), root}};
+    while (!pending.empty()) {
+        auto [syntax, copy] = pending.back();
+        pending.pop_back();
+        for (bool is_head : {true, false}) {
+            Object* part = is_head ? syntax->GetFirst() : syntax->GetSecond();
+            if (Is<Cell>(part) && IsSyntax(part)) {
+                Cell* part_copy = Make<Cell>();
+                pending.emplace_back(As<Cell>(part), part_copy);
+                part = part_copy;
+            } else {
+                part = Promote(part);
+            }
+            is_head ? copy->SetHead(part) : copy->SetTail(part);
+            // A cycle may finish in a Make of the copy, then older copies point to young ones
+            WriteBarrier(copy, part);
+        }
+    }
+    return root;
+}
+
+void Heap::Destroy(Object* object) noexcept {
+    object->~Object();
+    arena_.Free(object);
+}
+
+void SyntaxArena::Reset() noexcept {
+    if (chunks_.size() > 1) {
+        chunks_.resize(1);
+    }
+    offset_ = chunks_.empty() ? kChunkSize : 0;
+    size_ = 0;
 }
 
-void Heap::GarbageCollector(Object* target_scope) {
-    // Mark and Sweep
-    std::unordered_set<Object*> marks;
-    MarkingObjects(target_scope, marks);
-    Sweep(marks);
+void* SyntaxArena::Allocate(size_t size) {
+    size = (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+           alignof(std::max_align_t);
+    if (offset_ + size > kChunkSize) {
+        chunks_.push_back(std::make_unique<std::byte[]>(kChunkSize));
+        offset_ = 0;
+    }
+    void* slot = chunks_.back().get() + offset_;
+    offset_ += size;
+    return slot;
 }
@@ -1,10 +1,26 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <random>
+#include <type_traits>
 
+#include "arena.h"
 #include "error.h"
 #include "constans.h"
 
@@ -16,9 +32,95 @@ class Cell;
 class Lambda;
 class Scope;
 
-// Base class of all objects and states in Scheme
+// Index of the interned Symbol in the SymbolTable
+using SymbolId = uint32_t;
+
+// Permanent objects are immutable leaves shared by all heaps, e.g. #t and symbols.
+// Syntax objects live in a SyntaxArena until it is reset, the heap never refers to them.
+enum class Generation : uint8_t { NURSERY, SURVIVOR, OLD, PERMANENT, SYNTAX };
+
+// Tag of the concrete class of an object. Subclasses of an abstract class are contiguous,
+// so Is<T> is a compare with the tag of T or with the range of tags of its subclasses.
+enum class ObjectType : uint8_t {
+    OBJECT,
+    NUMBER,
+    SYMBOL,
+    BOOL,
+    CELL,
+    SCOPE,
+    CODE,
+    FRAME,
+    CLOSURE,
+    // Functions
+    QUOTE,
+    IF,
+    DEFINE,
+    SET,
+    MAKE_LAMBDA,
+    LAMBDA,
+    AND,
+    OR,
+    // Procedures
+    IS_BOOL,
+    IS_NUMBER,
+    IS_SYMBOL,
+    IS_PAIR,
+    IS_NULL,
+    IS_LIST,
+    NOT,
+    EQUAL,
+    LESS,
+    GREATER,
+    LESS_EQUAL,
+    GREATER_EQUAL,
+    ADD,
+    PRODUCT,
+    SUB,
+    DIVIDE,
+    MAX,
+    MIN,
+    ABS,
+    CONS,
+    CAR,
+    CDR,
+    LIST,
+    LIST_REF,
+    LIST_TAIL,
+    SET_CAR,
+    SET_CDR,
+};
+
+// Base class of all objects and states in Scheme. Concrete classes declare their kType and
+// pass it to the constructor, abstract ones declare the kFirstType..kLastType of subclasses.
 class Object {
+    friend class Heap;
+    friend class SyntaxArena;
+
+public:
+    static constexpr ObjectType kFirstType = ObjectType::OBJECT;
+    static constexpr ObjectType kLastType = ObjectType::SET_CDR;
+
+private:
+    // Objects which aren't allocated on the Heap are never collected, so they are old
+    Generation generation_ = Generation::OLD;
+    ObjectType type_ = ObjectType::OBJECT;
+    // Object is marked if it equals the epoch of the current collection
+    uint32_t mark_epoch_ = 0;
+
 public:
+    Object() noexcept = default;
+
+    explicit Object(Generation generation) noexcept : generation_(generation) {
+    }
+
+    explicit Object(ObjectType type, Generation generation = Generation::OLD) noexcept
+            : generation_(generation), type_(type) {
+    }
+
+    ObjectType GetType() const noexcept {
+        return type_;
+    }
+
     virtual ~Object() = default;
 
     virtual Object* Eval(Scope*) {
@@ -32,113 +134,631 @@ public:
     virtual Object* Clone() {
         throw RuntimeError{"No Serialize"};
     }
+
+    // Pushes the objects referenced by this one, used by the garbage collector
+    virtual void Trace(std::vector<Object*>*) {
+    }
+
+    // Pushes the addresses of the references which may point to cells, the copying
+    // collector moves the cells and updates the references in place
+    virtual void TraceSlots(std::vector<Object**>*) {
+    }
 };
 
 // Helper functions
 
+// Integers which fit into 63 bits aren't allocated, they are stored in the pointer itself
+// as value << 1 | 1. Objects are aligned, so the low bit of a real pointer is always zero.
+constexpr NumericT kFixnumMax = (NumericT{1} << 62) - 1;
+constexpr NumericT kFixnumMin = -(NumericT{1} << 62);
+
+inline bool IsFixnum(const Object* obj) noexcept {
+    return reinterpret_cast<uintptr_t>(obj) & 1;
+}
+
 template <class T>
-T* As(Object* obj) {
-    return dynamic_cast<T*>(obj);
+bool Is(Object* obj) noexcept {
+    if (!obj || IsFixnum(obj)) {
+        return false;
+    }
+    if constexpr (requires { T::kType; }) {
+        return obj->GetType() == T::kType;
+    } else {
+        return T::kFirstType <= obj->GetType() && obj->GetType() <= T::kLastType;
+    }
 }
 
+// nullptr unless Is<T>
 template <class T>
-bool Is(Object* obj) {
-    return As<T>(obj) != nullptr;
+T* As(Object* obj) noexcept {
+    return Is<T>(obj) ? static_cast<T*>(obj) : nullptr;
 }
 
+// Objects which an evaluation of the tree walker holds on the C++ stack. The nodes live in the
+// frames of the evaluations and are linked from the innermost one.
+struct EvalRoots {
+    std::span<Object* const> objects;
+    EvalRoots* outer = nullptr;
+};
+
+// Collections of a heap since the last ResetCollectorStats
+struct CollectorStats {
+    size_t collections = 0;
+    // Incremental cycles started, the finished ones are counted in collections
+    size_t cycles = 0;
+    std::chrono::nanoseconds time{0};
+    // Collect calls and incremental steps, each one stops the mutator
+    size_t pauses = 0;
+    std::chrono::nanoseconds max_pause{0};
+    // Pause i is counted in bucket bit_width of its microseconds, the last one takes the rest
+    std::array<size_t, 24> pause_histogram{};
+    // Objects only become garbage between collections, so the largest heap a collection
+    // started with is the peak number of objects
+    size_t peak_size = 0;
+
+    // Upper bound of the given fraction of the pauses, rounded up to a power of two
+    std::chrono::microseconds GetPausePercentile(double fraction) const noexcept;
+};
+
+// Objects are allocated in the nursery, move to the survivors after the first collection
+// and are promoted to the old generation after the second one. Old objects which got
+// a reference to a young one are remembered by the write barrier until the next full
+// collection, so a minor collection traces only the young objects and the remembered ones.
+// Memory for the objects is taken from the size class slabs of the Arena.
+// Every Interpreter owns its heap, objects of different heaps must not refer to each other.
+//
+// A major collection is incremental unless it is full: Collect takes the snapshot of the roots
+// and later steps mark a bounded amount of objects, then sweep a bounded amount of slabs.
+// Steps run every kStepAllocations allocations in Make and on every Collect, minor
+// collections wait for the end of the cycle. The steps in Make never end the cycle: the caller
+// may be linking the objects allocated during it, which are old, to the young ones allocated
+// after it, without a barrier. The cycle ends at the next Step or Collect.
+// Marking is snapshot at the beginning: objects
+// reachable at the start or allocated during the cycle survive it, the latter are allocated
+// into the old generation. PreWriteBarrier shades the references which are overwritten,
+// so no path of the snapshot is lost.
+//
+// With SetConcurrent the cells and numbers of the cycle are marked by a background thread.
+// Other objects hold containers which the mutator changes, so the marker hands them back
+// and the steps trace them. The marker reads cells with the acquire loads paired with the
+// release stores of Cell, marks of the cycle are atomic.
 class Heap {
+public:
+    // Full collection runs when the old generation grows twice since the last one
+    static constexpr size_t kMinMajorThreshold = 4096;
+    static constexpr size_t kMarkStackReserve = 4096;
+    static constexpr size_t kGenerationReserve = 4096;
+    static constexpr size_t kPrefetchDistance = 8;
+    // Owners of the heap collect when it has grown kDefaultGrowthFactor times since the last
+    // collection, but at least by kMinCollectionBudget objects
+    static constexpr double kDefaultGrowthFactor = 2;
+    static constexpr size_t kMinCollectionBudget = 1024;
+    // Budget of one incremental step: objects marked or slots swept, and time
+    static constexpr size_t kStepObjects = 1 << 13;
+    static constexpr std::chrono::nanoseconds kStepTime = std::chrono::microseconds{500};
+    static constexpr size_t kStepAllocations = 1 << 10;
+    // Collector thread shares the older half of its mark stack when it has more objects
+    static constexpr size_t kMarkShareThreshold = 256;
+
 private:
-    std::unordered_set<Object*> objects_tree_;
+    // SWEPT cycle waits for a step which isn't made by an allocation to end it
+    enum class Phase : uint8_t { IDLE, MARKING, SWEEPING, SWEPT };
+
+    struct MarkWorker;
+
+    Arena arena_;
+    std::vector<Object*> nursery_;
+    std::vector<Object*> survivors_;
+    std::unordered_set<Object*> remembered_set_;
+    size_t old_count_ = 0;
+    size_t major_threshold_ = kMinMajorThreshold;
+    uint32_t epoch_ = 0;
+    std::vector<Object*> mark_stack_;
+    std::vector<Object*> references_;
+    CollectorStats collector_stats_;
+    double growth_factor_ = kDefaultGrowthFactor;
+    size_t min_collection_budget_ = kMinCollectionBudget;
+    size_t next_collection_size_ = kMinCollectionBudget;
+    Phase phase_ = Phase::IDLE;
+    bool is_incremental_ = true;
+    size_t step_objects_ = kStepObjects;
+    std::chrono::nanoseconds step_time_ = kStepTime;
+    size_t allocations_since_step_ = 0;
+    // Objects under construction aren't marked yet, so nested Make doesn't step
+    size_t constructing_depth_ = 0;
+    bool is_concurrent_ = false;
+    // Runs during the marking of a concurrent cycle, the fields below are guarded by the mutex
+    std::thread marker_;
+    std::mutex marker_mutex_;
+    std::condition_variable marker_cv_;
+    std::condition_variable mutator_cv_;
+    std::vector<Object*> marker_work_;
+    std::vector<Object*> mutator_work_;
+    bool is_marker_busy_ = false;
+    std::atomic<bool> is_marker_stopped_ = false;
+    size_t collector_threads_ = 1;
+    EvalRoots* eval_roots_ = nullptr;
+    std::function<void()> safe_point_;
+    size_t safe_point_nursery_size_ = 0;
 
 public:
-    static Heap& Instance() {
-        static Heap heap;
-        return heap;
+    Heap() {
+        mark_stack_.reserve(kMarkStackReserve);
+        nursery_.reserve(kGenerationReserve);
+        survivors_.reserve(kGenerationReserve);
+        references_.reserve(kMarkStackReserve);
     }
 
+    Heap(const Heap&) = delete;
+
+    Heap& operator=(const Heap&) = delete;
+
+    ~Heap();
+
     template <class T, class... Args>
     T* Make(Args&&... args) {
-        T* object = new T(std::forward<Args>(args)...);
-        objects_tree_.insert(object);
+        static_assert(sizeof(T) <= Arena::kMaxSlotSize, "Object doesn't fit into the slab slot");
+        const bool is_collecting = IsCollecting();
+        if (is_collecting) {
+            if (!constructing_depth_ && ++allocations_since_step_ >= kStepAllocations) {
+                StepCycle(false);
+            }
+            ++constructing_depth_;
+        }
+        void* slot = arena_.Allocate(sizeof(T));
+        T* object;
+        try {
+            object = new (slot) T(std::forward<Args>(args)...);
+        } catch (...) {
+            arena_.Free(slot);
+            constructing_depth_ -= is_collecting;
+            throw;
+        }
+        if (is_collecting) {
+            --constructing_depth_;
+            // Allocated black into the old generation: the cycle doesn't trace it and minor
+            // collections, which wait for the end of the cycle, don't get a huge nursery
+            object->mark_epoch_ = epoch_;
+            object->generation_ = Generation::OLD;
+            ++old_count_;
+            return object;
+        }
+        object->generation_ = Generation::NURSERY;
+        nursery_.push_back(object);
         return object;
     }
 
-    void GarbageCollector(Object* target_scope);
+    static bool IsYoung(Object* object) noexcept {
+        return object->generation_ < Generation::OLD;
+    }
 
-    void Destroy(Object* ptr);
+    // Heap references are non-null and aren't immediate values
+    static bool IsReference(Object* object) noexcept {
+        return object && !IsFixnum(object);
+    }
 
-    std::unordered_set<Object*>& GetObjects() {
-        return objects_tree_;
+    // Permanent objects are shared by the heaps, so the collector doesn't touch them
+    static bool IsTraced(Object* object) noexcept {
+        return IsReference(object) && object->generation_ < Generation::PERMANENT;
     }
 
-    void Clear() {
-        objects_tree_.clear();
+    static bool IsSyntax(Object* object) noexcept {
+        return IsReference(object) && object->generation_ == Generation::SYNTAX;
     }
 
-private:
-    void MarkingObjects(Object* current_object, std::unordered_set<Object*>& marks);
+    // Deep copy of a syntax object on the heap, for the syntax which outlives its arena.
+    // Other objects are returned as is.
+    Object* Promote(Object* object);
 
-    void Sweep(std::unordered_set<Object*>& marks);
+    // Must be called before a reference stored in a heap object is overwritten
+    void PreWriteBarrier(Object* old_value) {
+        if (phase_ == Phase::MARKING && IsTraced(old_value) && LoadMark(old_value) != epoch_) {
+            mark_stack_.push_back(old_value);
+        }
+    }
 
-    Heap() = default;
+    // Must be called after a reference to value is stored into owner
+    void WriteBarrier(Object* owner, Object* value) {
+        if (IsReference(value) && IsYoung(value) && !IsYoung(owner)) {
+            remembered_set_.insert(owner);
+        }
+    }
 
-    ~Heap() {
-        for (Object* object_ptr : objects_tree_) {
-            delete object_ptr;
+    // For roots which aren't allocated on the heap
+    void Remember(Object* owner) {
+        remembered_set_.insert(owner);
+    }
+
+    // Innermost evaluation of the tree walker in progress: its expression, scope and callee or
+    // the arguments evaluated so far
+    EvalRoots* GetEvalRoots() const noexcept {
+        return eval_roots_;
+    }
+
+    void SetEvalRoots(EvalRoots* eval_roots) noexcept {
+        eval_roots_ = eval_roots;
+    }
+
+    // Sets the collection run by SafePoint when the nursery grows over nursery_size, the owner
+    // of the heap collects with its own roots and GetEvalRoots
+    void SetSafePoint(size_t nursery_size, std::function<void()> collect) {
+        safe_point_nursery_size_ = nursery_size;
+        safe_point_ = std::move(collect);
+    }
+
+    // The tree walker calls it between tail calls, so the scopes of a loop don't pile up
+    // until the end of the Run
+    void SafePoint() {
+        if (IsCycleSwept()) {
+            Step();
+        } else if (safe_point_ && nursery_.size() > safe_point_nursery_size_ && !IsCollecting()) {
+            safe_point_();
         }
-        Clear();
+    }
+
+    // Mark and Sweep of the objects unreachable from roots. Collection is minor unless full is
+    // set or the old generation has grown over the threshold. A major collection which isn't
+    // full starts an incremental cycle, Collect during the cycle makes a step of it.
+    // Full collection finishes the cycle and collects everything at once.
+    void Collect(std::span<Object* const> roots, bool full = false);
+
+    // Full collection which then copies the live cells into new slabs breadth first, with
+    // the spine of each list in a row, so traversals of the lists touch adjacent memory.
+    // Other objects don't move. root_slots are the references from outside of the heap,
+    // the moved cells are updated in them and in the heap objects.
+    void CompactCells(std::span<Object** const> root_slots);
+
+    // Incremental cycle is in progress
+    bool IsCollecting() const noexcept {
+        return phase_ != Phase::IDLE;
+    }
+
+    // One step of the incremental cycle, the roots were taken at its start
+    void Step() {
+        StepCycle(true);
+    }
+
+    // All slabs are swept, the next Step ends the cycle
+    bool IsCycleSwept() const noexcept {
+        return phase_ == Phase::SWEPT;
+    }
+
+    // Major collections stop the world unless incremental is set
+    void SetIncremental(bool is_incremental) noexcept {
+        is_incremental_ = is_incremental;
+    }
+
+    // Marking of the next incremental cycles runs on a background thread
+    void SetConcurrent(bool is_concurrent) noexcept {
+        is_concurrent_ = is_concurrent;
+    }
+
+    // Stop the world major collections mark and sweep with threads_count threads
+    void SetCollectorThreads(size_t threads_count) noexcept {
+        collector_threads_ = std::max<size_t>(threads_count, 1);
+    }
+
+    // A step ends when it has marked or swept objects, marking also ends when time has passed
+    void SetStepBudget(size_t objects, std::chrono::nanoseconds time) noexcept {
+        step_objects_ = std::max<size_t>(objects, 1);
+        step_time_ = time;
+    }
+
+    // Objects allocated since the last collection exceed the budget
+    bool IsOverBudget() const noexcept {
+        return Size() >= next_collection_size_;
+    }
+
+    // Budget of the next collections is max(size * (growth_factor - 1), min_budget) objects,
+    // where size is the heap left by the last collection. 1 and 0 collect every time.
+    void SetCollectionBudget(double growth_factor, size_t min_budget) noexcept;
+
+    const std::vector<Object*>& GetNursery() const noexcept {
+        return nursery_;
+    }
+
+    const std::vector<Object*>& GetSurvivors() const noexcept {
+        return survivors_;
+    }
+
+    size_t GetOldCount() const noexcept {
+        return old_count_;
+    }
+
+    size_t Size() const noexcept {
+        return old_count_ + nursery_.size() + survivors_.size();
+    }
+
+    const Arena& GetArena() const noexcept {
+        return arena_;
+    }
+
+    const CollectorStats& GetCollectorStats() const noexcept {
+        return collector_stats_;
+    }
+
+    void ResetCollectorStats() noexcept {
+        collector_stats_ = {};
+    }
+
+private:
+    bool IsMarked(Object* object) const noexcept {
+        return object->mark_epoch_ == epoch_;
+    }
+
+    // Marks which the marker thread may access at the same time
+    static uint32_t LoadMark(Object* object) noexcept {
+        return std::atomic_ref{object->mark_epoch_}.load(std::memory_order_relaxed);
+    }
+
+    void StoreMark(Object* object) noexcept {
+        std::atomic_ref{object->mark_epoch_}.store(epoch_, std::memory_order_relaxed);
+    }
+
+    void NextEpoch();
+
+    // Marks everything reachable from the mark stack without recursion. Minor collection
+    // marks young objects only, old ones are alive until the next full collection.
+    // Stops after budget objects or at the deadline, returns true when the stack is empty.
+    bool MarkingObjects(bool young_only, size_t budget = SIZE_MAX,
+                        std::chrono::steady_clock::time_point deadline =
+                            std::chrono::steady_clock::time_point::max());
+
+    void StartCycle(std::span<Object* const> roots);
+
+    // may_finish is unset for the steps of the allocations
+    void StepCycle(bool may_finish);
+
+    // Runs the rest of the cycle without budget
+    void FinishCycle();
+
+    // Loop of the marker thread
+    void MarkConcurrently();
+
+    // Mutator part of the concurrent marking: traces the objects which aren't cells or numbers
+    // and passes the rest to the marker. Returns true when both have nothing left.
+    bool DrainConcurrentMarking(size_t budget);
+
+    void StopMarker();
+
+    // Marks everything reachable from the mark stack with the collector threads. Each thread
+    // has its own stack, idle threads steal the shared part of the others.
+    void MarkInParallel();
+
+    void RunMarkWorker(std::span<MarkWorker> workers, size_t index,
+                       std::atomic<size_t>* idle_count);
+
+    // Takes a part of the shared objects, the thread's own ones first
+    static bool StealMarkWork(std::span<MarkWorker> workers, size_t index);
+
+    // Sweep of the slabs by the collector threads
+    void SweepInParallel();
+
+    // Copies of the compaction are marked as survivors until it ends. The original stays
+    // unmarked with the copy as its head.
+    Cell* CopyCell(Cell* cell, std::vector<Cell*>* copies);
+
+    void ForwardSlot(Object** slot, std::vector<Cell*>* copies);
+
+    void SweepStep(size_t budget, bool may_finish = true);
+
+    void RecordPause(std::chrono::steady_clock::time_point start) noexcept;
+
+    void Sweep();
+
+    void SweepNursery();
+
+    void Destroy(Object* object) noexcept;
+};
+
+// Region of the syntax objects read for one Run. The objects aren't destroyed one by one,
+// Reset releases all of them at once.
+class SyntaxArena {
+public:
+    static constexpr size_t kChunkSize = 1 << 16;
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    // Bump allocation in chunks_.back()
+    size_t offset_ = kChunkSize;
+    size_t size_ = 0;
+
+public:
+    // Syntax objects own nothing, so skipping their destructors is fine
+    template <class T, class... Args>
+    T* Make(Args&&... args) {
+        static_assert(std::is_same_v<T, Cell> || std::is_same_v<T, Number>,
+                      "Only the parser output is allocated in the syntax arena");
+        T* object = new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+        object->generation_ = Generation::SYNTAX;
+        ++size_;
+        return object;
+    }
+
+    // Syntax is never collected, so the parser stores into it without barriers
+    void WriteBarrier(Object*, Object*) noexcept {
+    }
+
+    // Keeps the first chunk for the next Run
+    void Reset() noexcept;
+
+    size_t Size() const noexcept {
+        return size_;
+    }
+
+private:
+    void* Allocate(size_t size);
+};
+
+// Hits and misses of the caches of global bindings
+struct GlobalCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+
+    double GetHitRatio() const noexcept {
+        return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0;
     }
 };
 
 class Scope : public Object {
 public:
-    using Namespace = std::unordered_map<std::string, Object*>;
+    static constexpr ObjectType kType = ObjectType::SCOPE;
+
+    using Namespace = std::unordered_map<SymbolId, Object*>;
 
 private:
+    // Slots of the global scope by symbol id. A name which was never bound in a nested scope
+    // can only resolve to the global binding, so its lookup skips the chain of scopes.
+    // Slots of unordered_map don't move, define and set! store into the cached slot.
+    struct GlobalBindings {
+        std::vector<Object**> slots;
+        std::vector<bool> is_shadowed;
+        GlobalCacheStats stats;
+    };
+
+    Heap* heap_;
     Scope* parent_scope_ = nullptr;
+    Scope* global_scope_;
     Namespace namespace_;
+    // Only the global scope has it
+    std::unique_ptr<GlobalBindings> global_bindings_;
 
 public:
-    explicit Scope(Namespace&& a_namespace) : namespace_(a_namespace) {
+    explicit Scope(Heap* heap, Namespace&& a_namespace = {});
+
+    // Nested scope lives on the heap of its parent
+    explicit Scope(Scope* init_parent_scope)
+            : Object(kType),
+              heap_(init_parent_scope->heap_),
+              parent_scope_(init_parent_scope),
+              global_scope_(init_parent_scope->global_scope_) {
     }
 
-    explicit Scope(Scope* init_parent_scope = nullptr) : parent_scope_(init_parent_scope){};
+    void Define(SymbolId target_name, Object* value);
 
-    void Define(const std::string& target_name, Object* value) {
-        namespace_[target_name] = value;
-    }
+    // Slot of the nearest binding of target_name or nullptr if it is unbound.
+    // owner is set to the scope which holds the binding, stores into the slot need a barrier.
+    Object** Lookup(SymbolId target_name, Scope** owner = nullptr) noexcept;
 
-    bool Find(const std::string target_name) const noexcept;
+    // Lookups from this scope and its nested scopes which resolved to a global binding
+    const GlobalCacheStats& GetGlobalCacheStats() const noexcept {
+        return global_scope_->global_bindings_->stats;
+    }
 
-    Object*& Get(const std::string target_name);
+    void ResetGlobalCacheStats() noexcept {
+        global_scope_->global_bindings_->stats = {};
+    }
 
     [[maybe_unused]] Scope* GetParentScope() {
         return parent_scope_;
     }
 
-    Namespace& GetNamespace() {
+    Heap* GetHeap() noexcept {
+        return heap_;
+    }
+
+    // Bindings are added by Define only, so the caches see them
+    const Namespace& GetNamespace() const noexcept {
         return namespace_;
     }
+
+    void Trace(std::vector<Object*>* references) override;
+
+    void TraceSlots(std::vector<Object**>* slots) override;
+
+private:
+    void CacheSlot(SymbolId name, Object** slot);
 };
 
 std::vector<Object*> GetVectorFromCell(Object* cell_head, Scope* scope, bool eval = true);
 
 class Function : public Object {
 public:
+    static constexpr ObjectType kFirstType = ObjectType::QUOTE;
+    static constexpr ObjectType kLastType = ObjectType::SET_CDR;
+
+    explicit Function(ObjectType type) noexcept : Object(type) {
+    }
+
     virtual Object* Apply(Object*, Scope*) {
         throw RuntimeError{"No impl"};
     };
+
+    // Evaluates everything except the expression in tail position. If there is one, it is
+    // returned with *is_tail_call set and *scope replaced by the scope to evaluate it in.
+    // Cell::Eval loops over such expressions, so tail calls don't grow the C++ stack.
+    virtual Object* ApplyTail(Object* head, Scope** scope, bool* is_tail_call) {
+        *is_tail_call = false;
+        return Apply(head, *scope);
+    }
+
+protected:
+    // Apply for functions which implement ApplyTail
+    Object* ApplyByTail(Object* head, Scope* scope);
+};
+
+// Builtin function which works with already evaluated arguments.
+// Apply evaluates the arguments into an inline buffer, links them to the eval roots of the heap
+// too and forwards them to Call. The VM calls Call with a span over its stack, so calls of
+// builtins don't allocate.
+// Procedures which allocate their results are constructed with the heap of the interpreter.
+class Procedure : public Function {
+public:
+    static constexpr ObjectType kFirstType = ObjectType::IS_BOOL;
+    static constexpr ObjectType kLastType = ObjectType::SET_CDR;
+
+    // Apply keeps up to this many arguments on the C++ stack
+    static constexpr size_t kInlineArgsCount = 8;
+
+protected:
+    Heap* heap_ = nullptr;
+
+public:
+    explicit Procedure(ObjectType type, Heap* heap = nullptr) noexcept
+            : Function(type), heap_(heap) {
+    }
+
+    Object* Apply(Object* head, Scope* scope) override;
+
+    virtual Object* Call(std::span<Object*> args) = 0;
+
+    // Fast paths of the fixed arities, builtins override them to skip the span loops
+    virtual Object* Call1(Object* arg) {
+        Object* args[] = {arg};
+        return Call(args);
+    }
+
+    virtual Object* Call2(Object* lhs, Object* rhs) {
+        Object* args[] = {lhs, rhs};
+        return Call(args);
+    }
+
+    // Dispatches to the fast path of args.size()
+    Object* CallWith(std::span<Object*> args) {
+        switch (args.size()) {
+            case 1:
+                return Call1(args[0]);
+            case 2:
+                return Call2(args[0], args[1]);
+            default:
+                return Call(args);
+        }
+    }
 };
 
 // Proxy object for Numbers in Scheme
 class Number final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::NUMBER;
+
 private:
     NumericT value_ = 0;
 
 public:
-    constexpr Number() noexcept = default;
+    Number() noexcept : Object(kType) {
+    }
 
-    Number(NumericT init_value) noexcept : value_(init_value){};
+    Number(NumericT init_value) noexcept : Object(kType), value_(init_value){};
 
     Number(const Number& other) = default;
 
@@ -148,10 +768,6 @@ public:
         return value_;
     }
 
-    Object* Clone() override {
-        return Heap::Instance().Make<Number>(value_);
-    }
-
     Object* Eval(Scope*) override {
         return this;
     }
@@ -188,27 +804,31 @@ public:
     }
 };
 
-// Proxy object for Symbols in Schema
+// Proxy object for Symbols in Schema. Symbols are interned by the SymbolTable, so there is
+// one Symbol per name and symbols are compared by pointer or by id.
 class Symbol final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::SYMBOL;
+
 private:
     std::string name_;
+    SymbolId id_;
 
 public:
-    Symbol() noexcept = default;
-
-    Symbol(const std::string& init_name) noexcept : name_(init_name) {
+    Symbol(std::string_view init_name, SymbolId init_id)
+            : Object(kType, Generation::PERMANENT), name_(init_name), id_(init_id) {
     }
 
     Object* Clone() override {
-        return Heap::Instance().Make<Symbol>(name_);
+        return this;
     }
 
     const std::string& GetName() const noexcept {
         return name_;
     }
 
-    void SetName(const std::string& new_name) noexcept {
-        name_ = new_name;
+    SymbolId GetId() const noexcept {
+        return id_;
     }
 
     std::string Serialize() override {
@@ -218,19 +838,70 @@ public:
     Object* Eval(Scope* scope) override;
 };
 
+// Interned symbols live until the end of the program, they aren't allocated on the Heap.
+// Ids are given in the order of interning, the ones of the symbols used by the interpreter
+// itself are known in advance.
+class SymbolTable {
+public:
+    enum : SymbolId { kDot, kQuote };
+
+private:
+    // Symbols are shared by the interpreters of all threads
+    std::mutex mutex_;
+    // deque doesn't move the symbols, so the index can refer to their names
+    std::deque<Symbol> symbols_;
+    std::unordered_map<std::string_view, Symbol*> index_;
+
+public:
+    static SymbolTable& Instance() {
+        static SymbolTable table;
+        return table;
+    }
+
+    Symbol* Intern(std::string_view name);
+
+    Symbol* Get(SymbolId id) {
+        std::lock_guard lock{mutex_};
+        return &symbols_[id];
+    }
+
+    size_t Size() {
+        std::lock_guard lock{mutex_};
+        return symbols_.size();
+    }
+
+private:
+    SymbolTable() {
+        Intern(".");
+        Intern("quote");
+    }
+};
+
+inline Symbol* Intern(std::string_view name) {
+    return SymbolTable::Instance().Intern(name);
+}
+
 // Proxy object for Bool in Schema
 class Bool final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::BOOL;
+
 private:
     bool state_ = false;
 
 public:
-    constexpr Bool() noexcept = default;
+    Bool(bool init_state) noexcept : Object(kType, Generation::PERMANENT), state_(init_state) {
+    }
 
-    Bool(bool init_state) noexcept : state_(init_state) {
+    // #t and #f are preallocated, they are never created on the heap
+    static Bool* Get(bool state) noexcept {
+        static Bool true_value{true};
+        static Bool false_value{false};
+        return state ? &true_value : &false_value;
     }
 
     Object* Clone() override {
-        return Heap::Instance().Make<Bool>(state_);
+        return this;
     }
 
     bool GetState() const noexcept {
@@ -249,19 +920,45 @@ public:
     }
 };
 
+// Immediate numbers
+
+// Fixnum if value fits into it, Number boxed on the heap otherwise
+inline Object* MakeNumber(Heap* heap, NumericT value) {
+    if (value < kFixnumMin || value > kFixnumMax) {
+        return heap->Make<Number>(value);
+    }
+    return reinterpret_cast<Object*>(static_cast<uintptr_t>(value) << 1 | 1);
+}
+
+inline bool IsNumeric(Object* object) {
+    return IsFixnum(object) || Is<Number>(object);
+}
+
+// object must be IsNumeric
+inline NumericT GetNumeric(Object* object) {
+    if (IsFixnum(object)) {
+        return static_cast<NumericT>(reinterpret_cast<intptr_t>(object)) >> 1;
+    }
+    return As<Number>(object)->GetValue();
+}
+
+// Serialize which accepts immediate values, object must be non-null
+std::string SerializeObject(Object* object);
+
 class Cell final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::CELL;
+
 private:
     Object* head_ = nullptr;
     Object* tail_ = nullptr;
 
 public:
-    constexpr Cell() noexcept = default;
-
-    Cell(Object* init_head, Object* init_tail) : head_(init_head), tail_(init_tail) {
+    Cell() noexcept : Object(kType) {
     }
 
-    Object* Clone() override {
-        return Heap::Instance().Make<Cell>(head_->Clone(), tail_->Clone());
+    Cell(Object* init_head, Object* init_tail) noexcept
+            : Object(kType), head_(init_head), tail_(init_tail) {
     }
 
     Object* GetFirst() noexcept {
@@ -272,190 +969,310 @@ public:
         return tail_;
     }
 
+    // Released, the concurrent marker may read the cell at the same time
     void SetHead(Object* new_head) noexcept {
-        head_ = new_head;
+        std::atomic_ref{head_}.store(new_head, std::memory_order_release);
     }
 
     void SetTail(Object* new_tail) noexcept {
-        tail_ = new_tail;
+        std::atomic_ref{tail_}.store(new_tail, std::memory_order_release);
     }
 
     Object* Eval(Scope* scope) override;
 
     std::string Serialize() override;
+
+    void Trace(std::vector<Object*>* references) override {
+        // head is popped first, so a long list doesn't pile its elements up on the mark stack
+        references->push_back(tail_);
+        references->push_back(head_);
+    }
+
+    void TraceSlots(std::vector<Object**>* slots) override {
+        slots->push_back(&tail_);
+        slots->push_back(&head_);
+    }
+
+    // Trace of the concurrent marker
+    void TraceAcquire(std::vector<Object*>* references) {
+        references->push_back(std::atomic_ref{tail_}.load(std::memory_order_acquire));
+        references->push_back(std::atomic_ref{head_}.load(std::memory_order_acquire));
+    }
 };
 
 class Quote final : public Function {
 public:
+    static constexpr ObjectType kType = ObjectType::QUOTE;
+
+    Quote() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override;
+
+    // Value of (quote . head)
+    static Object* GetValue(Object* head);
 };
 
 //
 
-class CheckType : public Function {
+class CheckType : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kFirstType = ObjectType::IS_BOOL;
+    static constexpr ObjectType kLastType = ObjectType::IS_LIST;
+
+    explicit CheckType(ObjectType type) noexcept : Procedure(type) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call1(Object* arg) override {
+        return Bool::Get(IsTypeOf(arg));
+    }
 
 private:
-    virtual bool IsTypeOf(Object*, Scope*) {
+    virtual bool IsTypeOf(Object*) {
         throw RuntimeError{"Not impl"};
     };
 };
 
 class IsBool final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_BOOL;
+
+    IsBool() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 class IsNumber final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_NUMBER;
+
+    IsNumber() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 class IsSymbol final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_SYMBOL;
+
+    IsSymbol() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 class IsPair final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_PAIR;
+
+    IsPair() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 class IsNull final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_NULL;
+
+    IsNull() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 class IsList final : public CheckType {
+public:
+    static constexpr ObjectType kType = ObjectType::IS_LIST;
+
+    IsList() noexcept : CheckType(kType) {
+    }
+
 private:
-    bool IsTypeOf(Object* target_object, Scope* scope) override;
+    bool IsTypeOf(Object* target_object) override;
 };
 
 //
 
-template <class F>
+template <class F, ObjectType kTag>
 class BoolOperator : public Function {
 public:
+    static constexpr ObjectType kType = kTag;
+
+    BoolOperator() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override {
+        return ApplyByTail(head, scope);
+    }
+
+    Object* ApplyTail(Object* head, Scope** scope, bool* is_tail_call) override {
+        *is_tail_call = false;
         bool state = !bool_operation_func_(true, false);
         if (!head) {
-            return Heap::Instance().Make<Bool>(state);
+            return Bool::Get(state);
         }
         if (!Is<Cell>(head) || !As<Cell>(head)->GetFirst()) {
             throw RuntimeError{"Incorrect cell"};
         }
-        Object* object = nullptr;
-        while (head && Is<Cell>(head)) {
-            object = As<Cell>(head)->GetFirst()->Eval(scope);
+        // Value of the last argument is the result unless evaluation is short-circuited
+        while (Is<Cell>(As<Cell>(head)->GetSecond())) {
+            Object* object = As<Cell>(head)->GetFirst()->Eval(*scope);
             if (Is<Bool>(object)) {
                 state = bool_operation_func_(state, As<Bool>(object)->GetState());
             } else {
                 state = bool_operation_func_(state, true);
             }
-            head = As<Cell>(head)->GetSecond();
-            if (head && Is<Cell>(head) && state == bool_operation_func_(true, false)) {
-                return Heap::Instance().Make<Bool>(state);
+            if (state == bool_operation_func_(true, false)) {
+                return Bool::Get(state);
             }
+            head = As<Cell>(head)->GetSecond();
         }
-        if (state) {
-            return object;
-        }
-        return Heap::Instance().Make<Bool>(state);
-    };
+        *is_tail_call = true;
+        return As<Cell>(head)->GetFirst();
+    }
 
 private:
     F bool_operation_func_;
 };
 
-class Not final : public Function {
+class Not final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::NOT;
+
+    Not() noexcept : Procedure(kType) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call1(Object* arg) override;
 };
 
-class And final : public BoolOperator<std::logical_and<bool>> {};
+class And final : public BoolOperator<std::logical_and<bool>, ObjectType::AND> {};
 
-class Or final : public BoolOperator<std::logical_or<bool>> {};
+class Or final : public BoolOperator<std::logical_or<bool>, ObjectType::OR> {};
 
 //
 
-template <class F>
-class Comparator : public Function {
+template <class F, ObjectType kTag>
+class Comparator : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override {
-        if (!head) {
-            return Heap::Instance().Make<Bool>(true);
+    static constexpr ObjectType kType = kTag;
+
+    Comparator() noexcept : Procedure(kType) {
+    }
+
+    Object* Call(std::span<Object*> args) override {
+        if (args.empty()) {
+            return Bool::Get(true);
         }
-        std::vector<Object*> args = GetVectorFromCell(head, scope);
         if (args.size() < 2) {
             throw RuntimeError{"Incorrect compare args count, require > 1"};
         }
         for (size_t i = 0; i < args.size() - 1; ++i) {
-            if (!Is<Number>(args[i]) || !Is<Number>(args[i + 1])) {
+            if (!IsNumeric(args[i]) || !IsNumeric(args[i + 1])) {
                 throw RuntimeError{"Invalid args in compare func!"};
             }
             // monotonic functions
-            if (!compare_func_(*As<Number>(args[i]), *As<Number>(args[i + 1]))) {
-                return Heap::Instance().Make<Bool>(false);
+            if (!compare_func_(GetNumeric(args[i]), GetNumeric(args[i + 1]))) {
+                return Bool::Get(false);
             }
         }
-        return Heap::Instance().Make<Bool>(true);
+        return Bool::Get(true);
     };
 
+    Object* Call2(Object* lhs, Object* rhs) override {
+        if (!IsNumeric(lhs) || !IsNumeric(rhs)) {
+            throw RuntimeError{"Invalid args in compare func!"};
+        }
+        return Bool::Get(compare_func_(GetNumeric(lhs), GetNumeric(rhs)));
+    }
+
 private:
     F compare_func_;
 };
 
-class Equal final : public Comparator<std::equal_to<Number>> {};
+class Equal final : public Comparator<std::equal_to<NumericT>, ObjectType::EQUAL> {};
 
-class Less final : public Comparator<std::less<Number>> {};
+class Less final : public Comparator<std::less<NumericT>, ObjectType::LESS> {};
 
-class Greater final : public Comparator<std::greater<Number>> {};
+class Greater final : public Comparator<std::greater<NumericT>, ObjectType::GREATER> {};
 
-class LessEqual final : public Comparator<std::less_equal<Number>> {};
+class LessEqual final : public Comparator<std::less_equal<NumericT>, ObjectType::LESS_EQUAL> {};
 
-class GreaterEqual final : public Comparator<std::greater_equal<Number>> {};
+class GreaterEqual final
+    : public Comparator<std::greater_equal<NumericT>, ObjectType::GREATER_EQUAL> {};
 
 //
 
-template <class Operation, bool IsGroupOperation, NumericT NeutralElement = -1>
-class ArithmeticOperator : public Function {
+template <class Operation, ObjectType kTag, bool IsGroupOperation, NumericT NeutralElement = -1>
+class ArithmeticOperator : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override {
-        if (!head) {
+    static constexpr ObjectType kType = kTag;
+
+    explicit ArithmeticOperator(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override {
+        if (args.empty()) {
             if (!IsGroupOperation) {
                 throw RuntimeError{"Didn't support neutral element"};
             }
-            return Heap::Instance().Make<Number>(NeutralElement);
-        }
-        std::vector<Object*> args = GetVectorFromCell(head, scope);
-        if (args.empty()) {
-            return Heap::Instance().Make<Number>();
+            return MakeNumber(heap_, NeutralElement);
         }
-        if (!args.front() || !Is<Number>(args.front())) {
+        if (!IsNumeric(args.front())) {
             throw RuntimeError{"Incorrect args for arithmetics"};
         }
-        Number result = *As<Number>(args.front());
+        NumericT result = GetNumeric(args.front());
         for (size_t i = 1; i < args.size(); ++i) {
-            if (!Is<Number>(args[i])) {
+            if (!IsNumeric(args[i])) {
                 throw RuntimeError{"!!!!"};
             }
-            result = operation_func_(result, *As<Number>(args[i]));
+            result = operation_func_(result, GetNumeric(args[i]));
         }
-        return Heap::Instance().Make<Number>(result);
+        return MakeNumber(heap_, result);
     };
 
+    Object* Call2(Object* lhs, Object* rhs) override {
+        if (!IsNumeric(lhs) || !IsNumeric(rhs)) {
+            throw RuntimeError{"Incorrect args for arithmetics"};
+        }
+        return MakeNumber(heap_, operation_func_(GetNumeric(lhs), GetNumeric(rhs)));
+    }
+
 private:
     Operation operation_func_;
 };
 
-class Add final : public ArithmeticOperator<std::plus<Number>, true, 0> {};
+class Add final : public ArithmeticOperator<std::plus<NumericT>, ObjectType::ADD, true, 0> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
-class Product final : public ArithmeticOperator<std::multiplies<Number>, true, 1> {};
+class Product final
+    : public ArithmeticOperator<std::multiplies<NumericT>, ObjectType::PRODUCT, true, 1> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
-class Sub final : public ArithmeticOperator<std::minus<Number>, false> {};
+class Sub final : public ArithmeticOperator<std::minus<NumericT>, ObjectType::SUB, false> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
-class Divide final : public ArithmeticOperator<std::divides<Number>, false> {};
+class Divide final : public ArithmeticOperator<std::divides<NumericT>, ObjectType::DIVIDE, false> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
 template <class T>
 struct MaxOp {
@@ -471,92 +1288,182 @@ struct MinOp {
     }
 };
 
-class Max final : public ArithmeticOperator<MaxOp<Number>, false> {};
+class Max final : public ArithmeticOperator<MaxOp<NumericT>, ObjectType::MAX, false> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
-class Min final : public ArithmeticOperator<MinOp<Number>, false> {};
+class Min final : public ArithmeticOperator<MinOp<NumericT>, ObjectType::MIN, false> {
+public:
+    using ArithmeticOperator::ArithmeticOperator;
+};
 
 //
 
-class Abs final : public Function {
+class Abs final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::ABS;
+
+    explicit Abs(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call1(Object* arg) override;
 };
 
 //
 
-class Cons final : public Function {
+class Cons final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::CONS;
+
+    explicit Cons(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call2(Object* lhs, Object* rhs) override;
 };
 
-class Car final : public Function {
+class Car final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::CAR;
+
+    Car() noexcept : Procedure(kType) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call1(Object* arg) override;
 };
 
-class Cdr final : public Function {
+class Cdr final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::CDR;
+
+    Cdr() noexcept : Procedure(kType) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
+
+    Object* Call1(Object* arg) override;
 };
 
-class List final : public Function {
+class List final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::LIST;
+
+    explicit List(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
 };
 
-class ListRef final : public Function {
+class ListRef final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::LIST_REF;
+
+    ListRef() noexcept : Procedure(kType) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
 };
 
-class ListTail final : public Function {
+class ListTail final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::LIST_TAIL;
+
+    explicit ListTail(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
 };
 
 class If final : public Function {
 public:
+    static constexpr ObjectType kType = ObjectType::IF;
+
+    If() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override;
+
+    Object* ApplyTail(Object* head, Scope** scope, bool* is_tail_call) override;
 };
 
 class Define final : public Function {
 public:
+    static constexpr ObjectType kType = ObjectType::DEFINE;
+
+    Define() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override;
 };
 
 class Set final : public Function {
 public:
+    static constexpr ObjectType kType = ObjectType::SET;
+
+    Set() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override;
 };
 
-class SetCar final : public Function {
+class SetCar final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::SET_CAR;
+
+    explicit SetCar(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
 };
 
-class SetCdr final : public Function {
+class SetCdr final : public Procedure {
 public:
-    Object* Apply(Object* head, Scope* scope) override;
+    static constexpr ObjectType kType = ObjectType::SET_CDR;
+
+    explicit SetCdr(Heap* heap) noexcept : Procedure(kType, heap) {
+    }
+
+    Object* Call(std::span<Object*> args) override;
 };
 
 class MakeLambda final : public Function {
 public:
+    static constexpr ObjectType kType = ObjectType::MAKE_LAMBDA;
+
+    MakeLambda() noexcept : Function(kType) {
+    }
+
     Object* Apply(Object* head, Scope* scope) override;
 };
 
 class Lambda final : public Function {
+public:
+    static constexpr ObjectType kType = ObjectType::LAMBDA;
+
 private:
     Scope* scope_ = nullptr;
-    std::vector<std::string> args_;
+    std::vector<SymbolId> args_;
     std::vector<Object*> body_;
 
 public:
     // Some ctrs
-    Lambda(std::vector<std::string> args, std::vector<Object*> body, Scope* parent_scope);
+    Lambda(std::vector<SymbolId> args, std::vector<Object*> body, Scope* parent_scope);
 
     Object* Apply(Object* ptr, Scope* scope) override;
 
-    [[maybe_unused]] std::vector<std::string>& GetArgs() {
+    Object* ApplyTail(Object* head, Scope** scope, bool* is_tail_call) override;
+
+    void Trace(std::vector<Object*>* references) override;
+
+    void TraceSlots(std::vector<Object**>* slots) override;
+
+    [[maybe_unused]] std::vector<SymbolId>& GetArgs() {
         return args_;
     }
 
@@ -569,6 +1476,6 @@ public:
     }
 
     Object* Clone() override {
-        return Heap::Instance().Make<Lambda>(args_, body_, scope_);
+        return scope_->GetHeap()->Make<Lambda>(args_, body_, scope_);
     };
 };
@@ -0,0 +1,73 @@
+#include "parse_cache.h"
+
+namespace {
+
+// Quote returns its datum itself, so a quoted pair would be shared by the runs and
+// set-car! on it would change the result of the next run of the same source
+bool HasQuotedPair(Object* expression) {
+    Symbol* quote = SymbolTable::Instance().Get(SymbolTable::kQuote);
+    std::vector<Object*> pending{expression};
+    while (!pending.empty()) {
+        Object* object = pending.back();
+        pending.pop_back();
+        if (!Is<Cell>(object)) {
+            continue;
+        }
+        Cell* cell = As<Cell>(object);
+        if (cell->GetFirst() == quote && Is<Cell>(cell->GetSecond())) {
+            return true;
+        }
+        pending.push_back(cell->GetFirst());
+        pending.push_back(cell->GetSecond());
+    }
+    return false;
+}
+
+}  // namespace
+
+void ParseCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    while (entries_.size() > capacity_) {
+        index_.erase(entries_.back().source);
+        entries_.pop_back();
+    }
+}
+
+Object* ParseCache::Find(std::string_view source) {
+    if (!capacity_) {
+        return nullptr;
+    }
+    auto index_it = index_.find(source);
+    if (index_it == index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, index_it->second);
+    return index_it->second->expression;
+}
+
+bool ParseCache::Accepts(std::string_view source, Object* expression) const {
+    return capacity_ && !index_.contains(source) && !HasQuotedPair(expression);
+}
+
+void ParseCache::Insert(std::string_view source, Object* expression) {
+    if (entries_.size() == capacity_) {
+        index_.erase(entries_.back().source);
+        entries_.pop_back();
+    }
+    entries_.push_front({std::string{source}, expression});
+    index_.emplace(entries_.front().source, entries_.begin());
+}
+
+void ParseCache::AppendRoots(std::vector<Object*>* roots) const {
+    for (const Entry& entry : entries_) {
+        roots->push_back(entry.expression);
+    }
+}
+
+void ParseCache::AppendRootSlots(std::vector<Object**>* slots) {
+    for (Entry& entry : entries_) {
+        slots->push_back(&entry.expression);
+    }
+}
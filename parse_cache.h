@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Parsed expressions of Run keyed by their source text with LRU eviction. The cached
+// expressions are roots of the heap, they are shared by all the runs of the same source,
+// so only the expressions which nothing can mutate are cached.
+class ParseCache {
+private:
+    struct Entry {
+        std::string source;
+        Object* expression;
+    };
+
+    size_t capacity_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    // From the most to the least recently used
+    std::list<Entry> entries_;
+    // Keys refer to the sources of the entries
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+
+public:
+    // The cache is disabled until it is given a capacity
+    void SetCapacity(size_t capacity);
+
+    size_t GetCapacity() const noexcept {
+        return capacity_;
+    }
+
+    // Returns nullptr and counts a miss if the source isn't cached
+    Object* Find(std::string_view source);
+
+    // The expression is safe to share between the runs and the cache is enabled
+    bool Accepts(std::string_view source, Object* expression) const;
+
+    // The expression must be accepted and allocated on the heap
+    void Insert(std::string_view source, Object* expression);
+
+    void AppendRoots(std::vector<Object*>* roots) const;
+
+    // The copying collector moves the cells of the expressions
+    void AppendRootSlots(std::vector<Object**>* slots);
+
+    size_t GetHits() const noexcept {
+        return hits_;
+    }
+
+    size_t GetMisses() const noexcept {
+        return misses_;
+    }
+
+    size_t GetSize() const noexcept {
+        return entries_.size();
+    }
+};
@@ -1,70 +1,139 @@
 #include <parser.h>
 
 #include <variant>
+#include <vector>
 
-Object* Read(Tokenizer* tokenizer) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError{"Nothing to read!"};
-    }
-    auto current_token = tokenizer->GetToken();
-    tokenizer->Next();  // Reading the next token
-    if (ConstantToken* constant_current_token = std::get_if<ConstantToken>(&current_token)) {
-        return Heap::Instance().Make<Number>(constant_current_token->value);
-    } else if (SymbolToken* symbol_current_token = std::get_if<SymbolToken>(&current_token)) {
-        return Heap::Instance().Make<Symbol>(symbol_current_token->name);
-    } else if (BooleanToken* boolean_current_token = std::get_if<BooleanToken>(&current_token)) {
-        return Heap::Instance().Make<Bool>(boolean_current_token->state);
-    } else if (std::holds_alternative<DotToken>(current_token)) {
-        return Heap::Instance().Make<Symbol>(".");
-    } else if (std::holds_alternative<QuoteToken>(current_token)) {
-        return Heap::Instance().Make<Cell>(Heap::Instance().Make<Symbol>("quote"), Read(tokenizer));
-    } else if (BracketToken* bracket_current_token = std::get_if<BracketToken>(&current_token)) {
-        if (*bracket_current_token == BracketToken::CLOSE) {
-            throw SyntaxError{"Expected '(' but you input ')'"};
-        }
-        return ReadList(tokenizer);
-    } else {
-        throw SyntaxError{"Unknown sequence"};
-    }
+namespace {
+
+bool IsClose(const Token& token) {
+    const BracketToken* bracket = std::get_if<BracketToken>(&token);
+    return bracket && *bracket == BracketToken::CLOSE;
 }
 
-Object* ReadList(Tokenizer* tokenizer) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError{"Some error"};
+// A datum whose parts are being read. Lists grow by appending to the last cell, so only
+// nesting takes a frame and the native stack doesn't depend on the input at all.
+struct ReadFrame {
+    enum class Kind {
+        LIST,    // ( [elements]
+        DOTTED,  // ( [elements] . and waits for the tail
+        QUOTE,   // ' and waits for the quoted datum
+    };
+
+    Kind kind;
+    Cell* first = nullptr;
+    Cell* last = nullptr;
+};
+
+// Reads an atom into *value or starts a compound datum on the stack, then returns false
+template <class Allocator>
+bool ReadAtom(Tokenizer* tokenizer, Allocator* allocator, std::vector<ReadFrame>* stack,
+              Object** value) {
+    const Token& token = tokenizer->GetToken();
+    if (const SymbolToken* symbol_token = std::get_if<SymbolToken>(&token)) {
+        // Name refers to the tokenizer, so the symbol is interned before the next token
+        *value = Intern(symbol_token->name);
+        tokenizer->Next();
+        return true;
     }
-    auto current_token = tokenizer->GetToken();
-    if (std::holds_alternative<BracketToken>(current_token) &&
-        std::get<BracketToken>(current_token) == BracketToken::CLOSE) {
-        tokenizer->Next();  // Reading the next token
-        return nullptr;
+    if (const ConstantToken* constant_token = std::get_if<ConstantToken>(&token)) {
+        *value = allocator->template Make<Number>(constant_token->value);
+        tokenizer->Next();
+        return true;
     }
-
-    // Pair (Cell): ( [head] [DotToken (is pair) / " " (is list)] [tail] )
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError{"The cell is not closed"};
+    if (const BooleanToken* boolean_token = std::get_if<BooleanToken>(&token)) {
+        *value = Bool::Get(boolean_token->state);
+        tokenizer->Next();
+        return true;
     }
-    Object* head = Read(tokenizer);
+    if (std::holds_alternative<DotToken>(token)) {
+        *value = SymbolTable::Instance().Get(SymbolTable::kDot);
+        tokenizer->Next();
+        return true;
+    }
+    if (std::holds_alternative<QuoteToken>(token)) {
+        tokenizer->Next();
+        stack->push_back({ReadFrame::Kind::QUOTE});
+        return false;
+    }
+    if (IsClose(token)) {
+        throw SyntaxError{"Expected '(' but you input ')'"};
+    }
+    tokenizer->Next();
+    stack->push_back({ReadFrame::Kind::LIST});
+    return false;
+}
 
+// Allocator is the Heap or the SyntaxArena
+template <class Allocator>
+Object* ReadDatum(Tokenizer* tokenizer, Allocator* allocator) {
     if (tokenizer->IsEnd()) {
-        throw SyntaxError{"Some error"};
+        throw SyntaxError{"Nothing to read!"};
     }
-    current_token = tokenizer->GetToken();
-    if (std::holds_alternative<DotToken>(current_token)) {  // Is pair?
-        tokenizer->Next();
-        Object* tail = Read(tokenizer);
+    std::vector<ReadFrame> stack;
+    while (true) {
         if (tokenizer->IsEnd()) {
             throw SyntaxError{"The cell is not closed"};
         }
-        current_token = tokenizer->GetToken();
-        if (std::holds_alternative<BracketToken>(current_token) &&
-            std::get<BracketToken>(current_token) == BracketToken::CLOSE) {
-            tokenizer->Next();  // Reading the next token
-            return Heap::Instance().Make<Cell>(head, tail);
-        } else {
-            throw SyntaxError{"Not supported syntax"};
+        Object* value = nullptr;
+        ReadFrame* top = stack.empty() ? nullptr : &stack.back();
+        if (top && top->kind == ReadFrame::Kind::LIST && IsClose(tokenizer->GetToken())) {
+            tokenizer->Next();
+            value = top->first;
+            stack.pop_back();
+        } else if (top && top->kind == ReadFrame::Kind::LIST && top->last &&
+                   std::holds_alternative<DotToken>(tokenizer->GetToken())) {
+            // Pair (Cell): ( [head] [DotToken (is pair) / " " (is list)] [tail] )
+            tokenizer->Next();
+            top->kind = ReadFrame::Kind::DOTTED;
+            continue;
+        } else if (!ReadAtom(tokenizer, allocator, &stack, &value)) {
+            continue;
+        }
+
+        // The datum is complete, so it goes to the frames which wait for it
+        while (true) {
+            if (stack.empty()) {
+                return value;
+            }
+            ReadFrame& frame = stack.back();
+            if (frame.kind == ReadFrame::Kind::LIST) {
+                Cell* cell = allocator->template Make<Cell>(value, nullptr);
+                if (frame.last) {
+                    frame.last->SetTail(cell);
+                    allocator->WriteBarrier(frame.last, cell);
+                } else {
+                    frame.first = cell;
+                }
+                frame.last = cell;
+                break;
+            }
+            if (frame.kind == ReadFrame::Kind::QUOTE) {
+                Symbol* quote = SymbolTable::Instance().Get(SymbolTable::kQuote);
+                value = allocator->template Make<Cell>(quote, value);
+                stack.pop_back();
+                continue;
+            }
+            frame.last->SetTail(value);
+            allocator->WriteBarrier(frame.last, value);
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError{"The cell is not closed"};
+            }
+            if (!IsClose(tokenizer->GetToken())) {
+                throw SyntaxError{"Not supported syntax"};
+            }
+            tokenizer->Next();
+            value = frame.first;
+            stack.pop_back();
         }
-    } else {  // Is list?
-        Object* tail = ReadList(tokenizer);
-        return Heap::Instance().Make<Cell>(head, tail);
     }
 }
+
+}  // namespace
+
+Object* Read(Tokenizer* tokenizer, Heap* heap) {
+    return ReadDatum(tokenizer, heap);
+}
+
+Object* Read(Tokenizer* tokenizer, SyntaxArena* arena) {
+    return ReadDatum(tokenizer, arena);
+}
@@ -6,6 +6,9 @@
 #include <tokenizer.h>
 #include <error.h>
 
-Object* Read(Tokenizer* tokenizer);
+// Objects of the AST are allocated on the given heap. Lists are read without recursion,
+// so neither their length nor their depth is limited by the C++ stack.
+Object* Read(Tokenizer* tokenizer, Heap* heap);
 
-Object* ReadList(Tokenizer* tokenizer);
\ No newline at end of file
+// The result is valid until the arena is reset, Heap::Promote copies what has to outlive it
+Object* Read(Tokenizer* tokenizer, SyntaxArena* arena);
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "scanner.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool IsSpace(char chr) noexcept {
+    return chr == ' ' || (chr >= '\t' && chr <= '\r');
+}
+
+#if defined(__x86_64__)
+
+// x - 9 <= 4 as unsigned covers \t \n \v \f \r
+void ClassifySse2(const char* block, uint64_t* spaces, uint64_t* structurals) {
+    *spaces = 0;
+    *structurals = 0;
+    for (size_t i = 0; i < StructuralScanner::kBlockSize; i += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        __m128i controls = _mm_sub_epi8(chars, _mm_set1_epi8('\t'));
+        __m128i space = _mm_or_si128(
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(_mm_min_epu8(controls, _mm_set1_epi8(4)), controls));
+        __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('(')),
+                         _mm_cmpeq_epi8(chars, _mm_set1_epi8(')'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\'')),
+                         _mm_cmpeq_epi8(chars, _mm_set1_epi8('.'))));
+        *spaces |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(space))) << i;
+        *structurals |=
+            static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(structural))) << i;
+    }
+    *structurals |= *spaces;
+}
+
+__attribute__((target("avx2"))) void ClassifyAvx2(const char* block, uint64_t* spaces,
+                                                  uint64_t* structurals) {
+    *spaces = 0;
+    *structurals = 0;
+    for (size_t i = 0; i < StructuralScanner::kBlockSize; i += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        __m256i controls = _mm256_sub_epi8(chars, _mm256_set1_epi8('\t'));
+        __m256i space = _mm256_or_si256(
+            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(controls, _mm256_set1_epi8(4)), controls));
+        __m256i structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('(')),
+                            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(')'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\'')),
+                            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('.'))));
+        *spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << i;
+        *structurals |=
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(structural))) << i;
+    }
+    *structurals |= *spaces;
+}
+
+#endif
+
+std::atomic<SimdLevel> simd_level{GetSupportedSimdLevel()};
+
+}  // namespace
+
+StructuralScanner::Classifier StructuralScanner::GetClassifier() noexcept {
+    switch (simd_level.load(std::memory_order_relaxed)) {
+#if defined(__x86_64__)
+        case SimdLevel::AVX2:
+            return ClassifyAvx2;
+        case SimdLevel::SSE2:
+            return ClassifySse2;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+SimdLevel GetSupportedSimdLevel() noexcept {
+#if defined(__x86_64__)
+    // Called from a static initializer, so cpu features may be not initialized yet
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+SimdLevel GetSimdLevel() noexcept {
+    return simd_level.load(std::memory_order_relaxed);
+}
+
+void SetSimdLevel(SimdLevel level) noexcept {
+    simd_level.store(std::min(level, GetSupportedSimdLevel()), std::memory_order_relaxed);
+}
+
+size_t StructuralScanner::SkipSpaces(size_t position) {
+    if (!classify_) {
+        while (position < source_.size() && IsSpace(source_[position])) {
+            ++position;
+        }
+        return position;
+    }
+    while (position < source_.size()) {
+        Load(position / kBlockSize * kBlockSize);
+        uint64_t non_spaces = ~spaces_ >> (position - block_begin_);
+        if (non_spaces) {
+            return std::min(position + __builtin_ctzll(non_spaces), source_.size());
+        }
+        position = block_begin_ + kBlockSize;
+    }
+    return source_.size();
+}
+
+size_t StructuralScanner::FindStructural(size_t position) {
+    if (!classify_) {
+        // Atom is checked by the caller character by character anyway
+        return source_.size();
+    }
+    while (position < source_.size()) {
+        Load(position / kBlockSize * kBlockSize);
+        uint64_t structurals = structurals_ >> (position - block_begin_);
+        if (structurals) {
+            return std::min(position + __builtin_ctzll(structurals), source_.size());
+        }
+        position = block_begin_ + kBlockSize;
+    }
+    return source_.size();
+}
+
+void StructuralScanner::Load(size_t block_begin) {
+    if (is_loaded_ && block_begin == block_begin_) {
+        return;
+    }
+    block_begin_ = block_begin;
+    is_loaded_ = true;
+    if (block_begin + kBlockSize <= source_.size()) {
+        classify_(source_.data() + block_begin, &spaces_, &structurals_);
+        return;
+    }
+    // The last block is padded with an atom character, so it stops the spaces only
+    std::array<char, kBlockSize> padded;
+    padded.fill('a');
+    std::memcpy(padded.data(), source_.data() + block_begin, source_.size() - block_begin);
+    classify_(padded.data(), &spaces_, &structurals_);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Instruction sets of the structural scanner, from the slowest to the fastest
+enum class SimdLevel { SCALAR, SSE2, AVX2 };
+
+// The best level supported by the CPU
+SimdLevel GetSupportedSimdLevel() noexcept;
+
+SimdLevel GetSimdLevel() noexcept;
+
+// For tests and benchmarks, level is clamped to the supported one
+void SetSimdLevel(SimdLevel level) noexcept;
+
+// Finds whitespace and structural characters ( ) ' . of the source by blocks of 64 bytes,
+// each block is classified into bitmasks at once with SIMD. # is a symbol character inside
+// of an atom, #t and #f are found by the tokenizer at the start of a token. Positions are
+// found in the masks of the current block, so the tokenizer loops over characters only inside
+// of the atoms.
+// Without SIMD the scanner falls back to the plain character loop.
+class StructuralScanner {
+public:
+    static constexpr size_t kBlockSize = 64;
+
+private:
+    using Classifier = void (*)(const char* block, uint64_t* spaces, uint64_t* structurals);
+
+    std::string_view source_;
+    // Chosen by the SIMD level at construction, nullptr for SCALAR
+    Classifier classify_ = nullptr;
+    size_t block_begin_ = 0;
+    // Bit i is set if the character at block_begin_ + i is of the class
+    uint64_t spaces_ = 0;
+    uint64_t structurals_ = 0;
+    bool is_loaded_ = false;
+
+public:
+    StructuralScanner() = default;
+
+    explicit StructuralScanner(std::string_view source)
+            : source_(source), classify_(GetClassifier()) {
+    }
+
+    // Position of the first non space character from position or the size of the source
+    size_t SkipSpaces(size_t position);
+
+    // Position of the first space or structural character from position or the size of the source
+    size_t FindStructural(size_t position);
+
+private:
+    static Classifier GetClassifier() noexcept;
+
+    void Load(size_t block_begin);
+};
@@ -1,73 +1,301 @@
 #include "scheme.h"
 
-#include <sstream>
+#include <algorithm>
 
 #include "tokenizer.h"
 #include "parser.h"
+#include "compiler.h"
 
-void Interpreter::Sweep(std::unordered_set<Object*>& marks) {
-    std::unordered_set<Object*> objects = Heap::Instance().GetObjects();
-    for (auto ptr : objects) {
-        if (marks.find(ptr) == marks.end()) {
-            Heap::Instance().Destroy(ptr);
-        }
+void Interpreter::GarbageCollector(std::initializer_list<Object*> roots, bool full) {
+    roots_.clear();
+    roots_.push_back(&global_scope_);
+    roots_.insert(roots_.end(), roots);
+    parse_cache_.AppendRoots(&roots_);
+    roots_.insert(roots_.end(), stack_.begin(), stack_.end());
+    for (EvalRoots* eval_roots = heap_.GetEvalRoots(); eval_roots; eval_roots = eval_roots->outer) {
+        roots_.insert(roots_.end(), eval_roots->objects.begin(), eval_roots->objects.end());
+    }
+    for (const CallFrame& call_frame : frames_) {
+        roots_.push_back(call_frame.code);
+        roots_.push_back(call_frame.frame);
     }
+    heap_.Collect(roots_, full);
+}
+
+void Interpreter::Collect() {
+    stack_.clear();
+    frames_.clear();
+    GarbageCollector({}, true);
+}
+
+void Interpreter::Compact() {
+    stack_.clear();
+    frames_.clear();
+    std::vector<Object**> root_slots;
+    global_scope_.TraceSlots(&root_slots);
+    parse_cache_.AppendRootSlots(&root_slots);
+    heap_.CompactCells(root_slots);
 }
 
-void Interpreter::MarkingObjects(Object* current_object, std::unordered_set<Object*>& marks) {
-    if (!current_object) {
-        return;
+Frame* Interpreter::LocalFrame(Frame* frame, const Instruction& instruction) {
+    for (uint16_t depth = instruction.depth; depth; --depth) {
+        frame = frame->GetParentFrame();
     }
-    std::vector<Object*> not_visited_children;
-    marks.insert(current_object);
-    if (Is<Cell>(current_object)) {
-        auto cell_ptr = As<Cell>(current_object);
-        not_visited_children.push_back(cell_ptr->GetFirst());
-        not_visited_children.push_back(cell_ptr->GetSecond());
-    } else if (Is<Lambda>(current_object)) {
-        auto lambda_ptr = As<Lambda>(current_object);
-        for (Object* to : lambda_ptr->GetBody()) {
-            not_visited_children.push_back(to);
-        }
-        not_visited_children.push_back(lambda_ptr->GetScope());
-    } else if (Is<Scope>(current_object)) {
-        auto scope_ptr = As<Scope>(current_object);
-        for (auto& [name, ptr] : scope_ptr->GetNamespace()) {
-            not_visited_children.push_back(ptr);
-        }
-        not_visited_children.push_back(scope_ptr->GetParentScope());
+    return frame;
+}
+
+Object*& Interpreter::LocalSlot(Frame* frame, const Instruction& instruction) {
+    return (*LocalFrame(frame, instruction))[instruction.arg];
+}
+
+Symbol* Interpreter::LocalName(Code* code, const Instruction& instruction) {
+    for (uint16_t depth = instruction.depth; depth; --depth) {
+        code = code->GetParentCode();
     }
-    for (auto to : not_visited_children) {
-        if (to && marks.find(to) == marks.end()) {
-            MarkingObjects(to, marks);
+    return SymbolTable::Instance().Get(code->GetLocalNames()[instruction.arg]);
+}
+
+Object** Interpreter::LookupEnclosing(Code* code, Frame* frame, const Instruction& instruction,
+                                      Object** owner) {
+    SymbolId name = LocalName(code, instruction)->GetId();
+    for (uint16_t depth = instruction.depth; depth; --depth) {
+        code = code->GetParentCode();
+        frame = frame->GetParentFrame();
+    }
+    for (code = code->GetParentCode(), frame = frame->GetParentFrame(); code;
+         code = code->GetParentCode(), frame = frame->GetParentFrame()) {
+        const auto& names = code->GetLocalNames();
+        auto name_it = std::find(names.rbegin(), names.rend(), name);
+        if (name_it != names.rend()) {
+            Object*& slot = (*frame)[names.rend() - name_it - 1];
+            if (slot != Frame::kUnbound) {
+                *owner = frame;
+                return &slot;
+            }
         }
     }
+    *owner = &global_scope_;
+    return global_scope_.Lookup(name);
 }
 
-void Interpreter::GarbageCollector() {
-    // Mark and Sweep
-    std::unordered_set<Object*> marks;
-    MarkingObjects(&global_scope_, marks);
-    Sweep(marks);
+Object* Interpreter::Execute(Code* code) {
+    stack_.clear();
+    frames_.clear();
+    size_t pc = 0;
+    Frame* frame = nullptr;
+    while (true) {
+        const Instruction& instruction = code->GetInstructions()[pc++];
+        switch (instruction.op) {
+            case OpCode::CONST:
+                stack_.push_back(code->GetConstants()[instruction.arg]);
+                break;
+            case OpCode::LOAD_LOCAL: {
+                Object* value = LocalSlot(frame, instruction);
+                if (value == Frame::kUnbound) {
+                    Object* owner = nullptr;
+                    Object** variable = LookupEnclosing(code, frame, instruction, &owner);
+                    if (!variable) {
+                        throw NameError{"Undefined command " +
+                                        LocalName(code, instruction)->GetName()};
+                    }
+                    value = *variable;
+                }
+                stack_.push_back(value);
+                break;
+            }
+            case OpCode::LOAD_GLOBAL: {
+                // Global slots never move and the compiler resolved the locals, so the cached
+                // slot stays right after define and set! of the variable
+                Object**& slot = code->GetGlobalSlot(instruction.arg);
+                if (slot) {
+                    ++global_cache_stats_.hits;
+                } else {
+                    ++global_cache_stats_.misses;
+                    auto symbol = static_cast<Symbol*>(code->GetConstants()[instruction.arg]);
+                    slot = global_scope_.Lookup(symbol->GetId());
+                    if (!slot) {
+                        throw NameError{"Undefined command " + symbol->GetName()};
+                    }
+                }
+                stack_.push_back(*slot);
+                break;
+            }
+            case OpCode::DEFINE_LOCAL:
+                heap_.PreWriteBarrier((*frame)[instruction.arg]);
+                (*frame)[instruction.arg] = stack_.back();
+                heap_.WriteBarrier(frame, stack_.back());
+                stack_.back() = nullptr;
+                break;
+            case OpCode::DEFINE_GLOBAL: {
+                auto symbol = static_cast<Symbol*>(code->GetConstants()[instruction.arg]);
+                global_scope_.Define(symbol->GetId(), stack_.back());
+                stack_.back() = nullptr;
+                break;
+            }
+            case OpCode::SET_LOCAL: {
+                Object** variable = &LocalSlot(frame, instruction);
+                Object* owner = LocalFrame(frame, instruction);
+                if (*variable == Frame::kUnbound) {
+                    variable = LookupEnclosing(code, frame, instruction, &owner);
+                    if (!variable) {
+                        throw NameError{"Invalid args Set 4"};
+                    }
+                }
+                heap_.PreWriteBarrier(*variable);
+                *variable = stack_.back();
+                heap_.WriteBarrier(owner, stack_.back());
+                stack_.back() = nullptr;
+                break;
+            }
+            case OpCode::SET_GLOBAL: {
+                auto symbol = static_cast<Symbol*>(code->GetConstants()[instruction.arg]);
+                Object** variable = global_scope_.Lookup(symbol->GetId());
+                if (!variable) {
+                    throw NameError{"Invalid args Set 4"};
+                }
+                heap_.PreWriteBarrier(*variable);
+                *variable = stack_.back();
+                heap_.WriteBarrier(&global_scope_, stack_.back());
+                stack_.back() = nullptr;
+                break;
+            }
+            case OpCode::POP:
+                stack_.pop_back();
+                break;
+            case OpCode::JUMP:
+                pc = instruction.arg;
+                break;
+            case OpCode::JUMP_IF_FALSE: {
+                Object* condition = stack_.back();
+                stack_.pop_back();
+                if (Is<Bool>(condition) && !As<Bool>(condition)->GetState()) {
+                    pc = instruction.arg;
+                }
+                break;
+            }
+            case OpCode::MAKE_CLOSURE: {
+                auto lambda_code = static_cast<Code*>(code->GetConstants()[instruction.arg]);
+                stack_.push_back(heap_.Make<Closure>(lambda_code, frame));
+                break;
+            }
+            case OpCode::APPLY_FORM: {
+                Object* callee = stack_.back();
+                if (!Is<Function>(callee) || Is<Procedure>(callee)) {
+                    ++pc;  // arguments are evaluated for the CALL
+                    break;
+                }
+                // The form runs in the current frame and returns to the JUMP over the CALL
+                stack_.pop_back();
+                Object*& cached = code->GetConstants()[instruction.arg + 1];
+                if (!cached || As<Cell>(cached)->GetFirst() != callee) {
+                    Compiler compiler{&heap_, &global_scope_};
+                    Code* form_code = compiler.CompileForm(
+                        As<Function>(callee), code->GetConstants()[instruction.arg],
+                        frame ? code : nullptr);
+                    heap_.PreWriteBarrier(cached);
+                    cached = heap_.Make<Cell>(callee, form_code);
+                    heap_.WriteBarrier(code, cached);
+                }
+                frames_.push_back({code, pc, frame});
+                code = As<Code>(As<Cell>(cached)->GetSecond());
+                pc = 0;
+                break;
+            }
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL: {
+                size_t args_count = instruction.arg;
+                size_t callee_index = stack_.size() - args_count - 1;
+                Object* callee = stack_[callee_index];
+                std::span<Object*> args{stack_.data() + callee_index + 1, args_count};
+                if (Is<Closure>(callee)) {
+                    auto closure = As<Closure>(callee);
+                    Code* lambda_code = closure->GetCode();
+                    if (lambda_code->GetArgsCount() != args_count) {
+                        throw RuntimeError{"Invalid args in lambda apply"};
+                    }
+                    // Callee and arguments are still on the stack, so they survive the collection.
+                    // During an incremental cycle the allocations make its steps.
+                    if (heap_.GetNursery().size() > kNurserySize && !heap_.IsCollecting()) {
+                        GarbageCollector({code, frame});
+                    } else if (heap_.IsCycleSwept()) {
+                        heap_.Step();  // the allocations don't end the cycle
+                    }
+                    Frame* local_frame = heap_.Make<Frame>(lambda_code->GetFrameSize(),
+                                                                      closure->GetFrame());
+                    std::copy(args.begin(), args.end(), local_frame->GetSlots().begin());
+                    stack_.resize(callee_index);
+                    // Tail call returns straight to our caller, the current frame is dropped
+                    if (instruction.op == OpCode::CALL) {
+                        frames_.push_back({code, pc, frame});
+                    }
+                    code = lambda_code;
+                    pc = 0;
+                    frame = local_frame;
+                } else if (Is<Procedure>(callee)) {
+                    Object* result = As<Procedure>(callee)->CallWith(args);
+                    stack_.resize(callee_index);
+                    stack_.push_back(result);
+                } else {
+                    throw RuntimeError{"didn't support (...) without function"};
+                }
+                break;
+            }
+            case OpCode::RETURN:
+                if (frames_.empty()) {
+                    Object* result = stack_.back();
+                    stack_.pop_back();
+                    return result;
+                }
+                code = frames_.back().code;
+                pc = frames_.back().pc;
+                frame = frames_.back().frame;
+                frames_.pop_back();
+                break;
+            case OpCode::FAIL_NIL:
+                throw RuntimeError{"Error in eval of cell head"};
+        }
+    }
 }
 
 std::string Interpreter::Run(const std::string& code) {
-    std::stringstream input_stream{code};
-    Tokenizer tokenizer{&input_stream};
-    Object* parser_result = Read(&tokenizer);
-    if (!tokenizer.IsEnd()) {
-        throw SyntaxError("Tokenizer error in parser process");
-    }
+    Object* parser_result = parse_cache_.Find(code);
     if (!parser_result) {
-        throw RuntimeError("Parser work error");
+        Tokenizer tokenizer{std::string_view{code}};
+        // The tree walker keeps the syntax in lambdas and returns literals, so it reads to the heap
+        syntax_arena_.Reset();
+        parser_result = eval_mode_ == EvalMode::BYTECODE ? Read(&tokenizer, &syntax_arena_)
+                                                         : Read(&tokenizer, &heap_);
+        if (!tokenizer.IsEnd()) {
+            throw SyntaxError("Tokenizer error in parser process");
+        }
+        if (!parser_result) {
+            throw RuntimeError("Parser work error");
+        }
+        if (parse_cache_.Accepts(code, parser_result)) {
+            parser_result = heap_.Promote(parser_result);
+            parse_cache_.Insert(code, parser_result);
+        }
+    }
+    Object* eval_result;
+    if (eval_mode_ == EvalMode::BYTECODE) {
+        Compiler compiler{&heap_, &global_scope_};
+        Code* compiled = compiler.Compile(parser_result);
+        syntax_arena_.Reset();
+        eval_result = Execute(compiled);
+    } else {
+        eval_result = parser_result->Eval(&global_scope_);
     }
-    Object* eval_result = parser_result->Eval(&global_scope_);
     std::string result;
     if (!eval_result) {
         result = "()";
     } else {
-        result = eval_result->Serialize();
+        result = SerializeObject(eval_result);
+    }
+    // Tiny expressions don't pay for tracing the globals every time
+    if (heap_.IsCollecting()) {
+        heap_.Step();
+    } else if (heap_.IsOverBudget()) {
+        GarbageCollector();
     }
-    GarbageCollector();
     return result;
 }
@@ -1,57 +1,150 @@
 #pragma once
 
+#include <initializer_list>
 #include <string>
+#include <vector>
 
 #include <object.h>
+#include <bytecode.h>
+#include <parse_cache.h>
+
+// How Run evaluates expressions: compile to bytecode and run it on the VM
+// or walk the AST with Object::Eval
+enum class EvalMode { BYTECODE, TREE_WALK };
 
 class Interpreter {
 private:
+    struct CallFrame {
+        Code* code;
+        size_t pc;
+        Frame* frame;
+    };
+
+    static constexpr size_t kStackReserve = 4096;
+    static constexpr size_t kFramesReserve = 1024;
+    // The VM collects garbage at calls and the tree walker between tail calls when the nursery
+    // grows over this size
+    static constexpr size_t kNurserySize = 1 << 16;
+
+    // Declared first, so objects are destroyed after everything which refers to them
+    Heap heap_;
     Scope global_scope_;
+    EvalMode eval_mode_;
+    std::vector<Object*> stack_;
+    std::vector<CallFrame> frames_;
+    std::vector<Object*> roots_;
+    // Call site caches of LOAD_GLOBAL
+    GlobalCacheStats global_cache_stats_;
+    ParseCache parse_cache_;
+    // The bytecode is compiled from the syntax of the current Run only, so it is read here
+    SyntaxArena syntax_arena_;
 
 public:
-    Interpreter()
-            : global_scope_({{"quote", Heap::Instance().Make<Quote>()},
-                             {"boolean?", Heap::Instance().Make<IsBool>()},
-                             {"number?", Heap::Instance().Make<IsNumber>()},
-                             {"pair?", Heap::Instance().Make<IsPair>()},
-                             {"null?", Heap::Instance().Make<IsNull>()},
-                             {"list?", Heap::Instance().Make<IsList>()},
-                             {"symbol?", Heap::Instance().Make<IsSymbol>()},
-                             {"not", Heap::Instance().Make<Not>()},
-                             {"and", Heap::Instance().Make<And>()},
-                             {"or", Heap::Instance().Make<Or>()},
-                             {"<", Heap::Instance().Make<Less>()},
-                             {">", Heap::Instance().Make<Greater>()},
-                             {"=", Heap::Instance().Make<Equal>()},
-                             {"<=", Heap::Instance().Make<LessEqual>()},
-                             {">=", Heap::Instance().Make<GreaterEqual>()},
-                             {"+", Heap::Instance().Make<Add>()},
-                             {"*", Heap::Instance().Make<Product>()},
-                             {"-", Heap::Instance().Make<Sub>()},
-                             {"/", Heap::Instance().Make<Divide>()},
-                             {"max", Heap::Instance().Make<Max>()},
-                             {"min", Heap::Instance().Make<Min>()},
-                             {"abs", Heap::Instance().Make<Abs>()},
-                             {"cons", Heap::Instance().Make<Cons>()},
-                             {"car", Heap::Instance().Make<Car>()},
-                             {"cdr", Heap::Instance().Make<Cdr>()},
-                             {"list", Heap::Instance().Make<List>()},
-                             {"list-ref", Heap::Instance().Make<ListRef>()},
-                             {"list-tail", Heap::Instance().Make<ListTail>()},
-                             {"define", Heap::Instance().Make<Define>()},
-                             {"set!", Heap::Instance().Make<Set>()},
-                             {"set-car!", Heap::Instance().Make<SetCar>()},
-                             {"set-cdr!", Heap::Instance().Make<SetCdr>()},
-                             {"if", Heap::Instance().Make<If>()},
-                             {"lambda", Heap::Instance().Make<MakeLambda>()}}) {
+    explicit Interpreter(EvalMode eval_mode = EvalMode::BYTECODE)
+            : global_scope_(&heap_,
+                            {{Intern("quote")->GetId(), heap_.Make<Quote>()},
+                             {Intern("boolean?")->GetId(), heap_.Make<IsBool>()},
+                             {Intern("number?")->GetId(), heap_.Make<IsNumber>()},
+                             {Intern("pair?")->GetId(), heap_.Make<IsPair>()},
+                             {Intern("null?")->GetId(), heap_.Make<IsNull>()},
+                             {Intern("list?")->GetId(), heap_.Make<IsList>()},
+                             {Intern("symbol?")->GetId(), heap_.Make<IsSymbol>()},
+                             {Intern("not")->GetId(), heap_.Make<Not>()},
+                             {Intern("and")->GetId(), heap_.Make<And>()},
+                             {Intern("or")->GetId(), heap_.Make<Or>()},
+                             {Intern("<")->GetId(), heap_.Make<Less>()},
+                             {Intern(">")->GetId(), heap_.Make<Greater>()},
+                             {Intern("=")->GetId(), heap_.Make<Equal>()},
+                             {Intern("<=")->GetId(), heap_.Make<LessEqual>()},
+                             {Intern(">=")->GetId(), heap_.Make<GreaterEqual>()},
+                             {Intern("+")->GetId(), heap_.Make<Add>(&heap_)},
+                             {Intern("*")->GetId(), heap_.Make<Product>(&heap_)},
+                             {Intern("-")->GetId(), heap_.Make<Sub>(&heap_)},
+                             {Intern("/")->GetId(), heap_.Make<Divide>(&heap_)},
+                             {Intern("max")->GetId(), heap_.Make<Max>(&heap_)},
+                             {Intern("min")->GetId(), heap_.Make<Min>(&heap_)},
+                             {Intern("abs")->GetId(), heap_.Make<Abs>(&heap_)},
+                             {Intern("cons")->GetId(), heap_.Make<Cons>(&heap_)},
+                             {Intern("car")->GetId(), heap_.Make<Car>()},
+                             {Intern("cdr")->GetId(), heap_.Make<Cdr>()},
+                             {Intern("list")->GetId(), heap_.Make<List>(&heap_)},
+                             {Intern("list-ref")->GetId(), heap_.Make<ListRef>()},
+                             {Intern("list-tail")->GetId(), heap_.Make<ListTail>(&heap_)},
+                             {Intern("define")->GetId(), heap_.Make<Define>()},
+                             {Intern("set!")->GetId(), heap_.Make<Set>()},
+                             {Intern("set-car!")->GetId(), heap_.Make<SetCar>(&heap_)},
+                             {Intern("set-cdr!")->GetId(), heap_.Make<SetCdr>(&heap_)},
+                             {Intern("if")->GetId(), heap_.Make<If>()},
+                             {Intern("lambda")->GetId(), heap_.Make<MakeLambda>()}}),
+              eval_mode_(eval_mode) {
+        stack_.reserve(kStackReserve);
+        frames_.reserve(kFramesReserve);
+        roots_.reserve(kStackReserve);
+        // Builtins are young, the global scope isn't on the heap to be traced in a minor GC
+        heap_.Remember(&global_scope_);
+        // The VM keeps its code and frame in locals, so only the tree walker collects there
+        if (eval_mode_ == EvalMode::TREE_WALK) {
+            heap_.SetSafePoint(kNurserySize, [this] { GarbageCollector(); });
+        }
     }
 
+    Interpreter(const Interpreter&) = delete;
+
+    Interpreter& operator=(const Interpreter&) = delete;
+
     std::string Run(const std::string&);
 
+    EvalMode GetEvalMode() const noexcept {
+        return eval_mode_;
+    }
+
+    Heap& GetHeap() noexcept {
+        return heap_;
+    }
+
+    // Full collection, Run collects only when the heap is over its collection budget
+    void Collect();
+
+    // Full collection which also moves the cells of each list next to each other
+    void Compact();
+
+    // Run reuses the parsed expressions of the last capacity sources, 0 disables the cache
+    void SetParseCacheCapacity(size_t capacity) {
+        parse_cache_.SetCapacity(capacity);
+    }
+
+    const ParseCache& GetParseCache() const noexcept {
+        return parse_cache_;
+    }
+
+    // Lookups of global variables served by the caches of the eval mode: the call site caches
+    // of the VM or the global slots of the tree walker
+    GlobalCacheStats GetGlobalCacheStats() const noexcept {
+        return eval_mode_ == EvalMode::BYTECODE ? global_cache_stats_
+                                                : global_scope_.GetGlobalCacheStats();
+    }
+
+    void ResetGlobalCacheStats() noexcept {
+        global_cache_stats_ = {};
+        global_scope_.ResetGlobalCacheStats();
+    }
+
 private:
-    void MarkingObjects(Object* current_object, std::unordered_set<Object*>& marks);
+    Object* Execute(Code* code);
+
+    static Frame* LocalFrame(Frame* frame, const Instruction& instruction);
+
+    static Object*& LocalSlot(Frame* frame, const Instruction& instruction);
+
+    // Name of the local variable of LOAD_LOCAL or SET_LOCAL
+    static Symbol* LocalName(Code* code, const Instruction& instruction);
 
-    void Sweep(std::unordered_set<Object*>& marks);
+    // A local whose body define hasn't run yet doesn't hide the variable of the same name in
+    // the enclosing frames or in the global scope, as in the tree walker. Returns the slot of
+    // that variable or nullptr, owner is set to the object which holds it.
+    Object** LookupEnclosing(Code* code, Frame* frame, const Instruction& instruction,
+                             Object** owner);
 
-    void GarbageCollector();
+    // Roots are the global scope, the VM stacks and the given objects
+    void GarbageCollector(std::initializer_list<Object*> roots = {}, bool full = false);
 };
@@ -3,4 +3,8 @@ add_library(interpreter
         parser.cpp
         scheme.cpp
         object.cpp
+        compiler.cpp
+        arena.cpp
+        scanner.cpp
+        parse_cache.cpp
 )
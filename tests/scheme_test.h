@@ -8,6 +8,11 @@
 
 class SchemeTest {
 public:
+    // The tests expect every Run to release its garbage
+    SchemeTest() {
+        interpreter_.GetHeap().SetCollectionBudget(1, 0);
+    }
+
     void ExpectEq(std::string expression, const std::string& result) {
         REQUIRE(interpreter_.Run(expression) == result);
     }
@@ -28,6 +33,10 @@ public:
         REQUIRE_THROWS_AS(interpreter_.Run(expression), NameError);
     }
 
+    Heap& GetHeap() {
+        return interpreter_.GetHeap();
+    }
+
 private:
     Interpreter interpreter_;
 };
@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <arena.h>
+
+TEST_CASE("Arena reuses freed slots of the same size class") {
+    Arena arena;
+    void* first = arena.Allocate(24);
+    void* second = arena.Allocate(24);
+    REQUIRE(first != second);
+    REQUIRE(reinterpret_cast<uintptr_t>(first) % 8 == 0);
+
+    arena.Free(first);
+    REQUIRE(arena.Allocate(20) == first);
+    // other size class lives in its own slab
+    void* big = arena.Allocate(200);
+    REQUIRE(arena.GetSlabsCount() == 2);
+    REQUIRE(arena.Allocate(24) != big);
+}
+
+TEST_CASE("Arena releases empty slabs") {
+    Arena arena;
+    std::vector<void*> slots;
+    for (size_t i = 0; i < 3 * Arena::kSlabSize / 32; ++i) {
+        slots.push_back(arena.Allocate(32));
+    }
+    REQUIRE(arena.GetSlabsCount() >= 3);
+
+    std::set<void*> kept;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (i % 1000 == 0) {
+            kept.insert(slots[i]);
+        } else {
+            arena.Free(slots[i]);
+        }
+    }
+    size_t visited = 0;
+    arena.ForEachSlot([&](void* slot) {
+        REQUIRE(kept.contains(slot));
+        ++visited;
+    });
+    REQUIRE(visited == kept.size());
+
+    for (size_t i = 0; i < slots.size(); i += 1000) {
+        if (i >= Arena::kSlabSize / 32) {
+            arena.Free(slots[i]);
+            kept.erase(slots[i]);
+        }
+    }
+    arena.ReleaseEmptySlabs();
+    REQUIRE(arena.GetSlabsCount() == 1);
+    // free slots of the remaining slab are reused before a new slab is allocated
+    for (size_t i = 0; i < 100; ++i) {
+        REQUIRE(!kept.contains(arena.Allocate(32)));
+    }
+    REQUIRE(arena.GetSlabsCount() == 1);
+}
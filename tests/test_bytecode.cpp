@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <catch.hpp>
+
+#include <compiler.h>
+#include <parser.h>
+#include <scheme.h>
+
+namespace {
+
+std::string RunCatching(Interpreter* interpreter, const std::string& expression) {
+    try {
+        return interpreter->Run(expression);
+    } catch (const SyntaxError&) {
+        return "SyntaxError";
+    } catch (const RuntimeError&) {
+        return "RuntimeError";
+    } catch (const NameError&) {
+        return "NameError";
+    }
+}
+
+size_t CountOps(Code* code, OpCode op) {
+    size_t count = 0;
+    for (const Instruction& instruction : code->GetInstructions()) {
+        count += instruction.op == op;
+    }
+    return count;
+}
+
+Code* CompileString(Scope* global_scope, const std::string& str) {
+    std::stringstream ss{str};
+    Tokenizer tokenizer{&ss};
+    Compiler compiler{global_scope->GetHeap(), global_scope};
+    return compiler.Compile(Read(&tokenizer, global_scope->GetHeap()));
+}
+
+}  // namespace
+
+TEST_CASE("Special forms are compiled into opcodes") {
+    Heap heap;
+    Scope global_scope{&heap,
+                       {{Intern("if")->GetId(), heap.Make<If>()},
+                        {Intern("and")->GetId(), heap.Make<And>()},
+                        {Intern("define")->GetId(), heap.Make<Define>()},
+                        {Intern("lambda")->GetId(), heap.Make<MakeLambda>()}}};
+
+    Code* code = CompileString(&global_scope, "(if (and x y) 1 2)");
+    REQUIRE(CountOps(code, OpCode::CALL) == 0);
+    REQUIRE(CountOps(code, OpCode::JUMP_IF_FALSE) == 2);
+
+    code = CompileString(&global_scope, "(define (f x) (g x))");
+    REQUIRE(CountOps(code, OpCode::CALL) == 0);
+    REQUIRE(CountOps(code, OpCode::MAKE_CLOSURE) == 1);
+    REQUIRE(CountOps(code, OpCode::DEFINE_GLOBAL) == 1);
+
+    // parameter shadows the special form
+    code = CompileString(&global_scope, "(lambda (if) (if 1 2))");
+    auto lambda_code = As<Code>(code->GetConstants()[code->GetInstructions()[0].arg]);
+    REQUIRE(CountOps(lambda_code, OpCode::TAIL_CALL) == 1);
+    REQUIRE(CountOps(lambda_code, OpCode::JUMP_IF_FALSE) == 0);
+
+    // only the call in tail position replaces the frame
+    code = CompileString(&global_scope, "(lambda (x) (f x) (if x (g (h x)) (and x (k x))))");
+    lambda_code = As<Code>(code->GetConstants()[code->GetInstructions()[0].arg]);
+    REQUIRE(CountOps(lambda_code, OpCode::CALL) == 2);
+    REQUIRE(CountOps(lambda_code, OpCode::TAIL_CALL) == 2);
+}
+
+TEST_CASE("Local variables are addressed by frame slots") {
+    Heap heap;
+    Scope global_scope{&heap,
+                       {{Intern("define")->GetId(), heap.Make<Define>()},
+                        {Intern("lambda")->GetId(), heap.Make<MakeLambda>()}}};
+
+    Code* code = CompileString(&global_scope, "(lambda (x y) (define z y) (lambda () (+ x z)))");
+    auto outer_code = As<Code>(code->GetConstants()[code->GetInstructions()[0].arg]);
+    REQUIRE(outer_code->GetArgsCount() == 2);
+    REQUIRE(outer_code->GetFrameSize() == 3);
+
+    const auto& outer = outer_code->GetInstructions();
+    REQUIRE(outer[0].op == OpCode::LOAD_LOCAL);
+    REQUIRE(outer[0].arg == 1);
+    REQUIRE(outer[1].op == OpCode::DEFINE_LOCAL);
+    REQUIRE(outer[1].arg == 2);
+
+    auto make_closure = std::find_if(outer.begin(), outer.end(), [](const auto& instruction) {
+        return instruction.op == OpCode::MAKE_CLOSURE;
+    });
+    REQUIRE(make_closure != outer.end());
+    const auto& inner = As<Code>(outer_code->GetConstants()[make_closure->arg])->GetInstructions();
+    REQUIRE(inner[0].op == OpCode::LOAD_GLOBAL);
+    // the jump over the arguments is taken if + is a special form
+    REQUIRE(inner[1].op == OpCode::APPLY_FORM);
+    REQUIRE(inner[2].op == OpCode::JUMP);
+    REQUIRE(inner[3].op == OpCode::LOAD_LOCAL);
+    REQUIRE(inner[3].depth == 1);
+    REQUIRE(inner[3].arg == 0);
+    REQUIRE(inner[4].op == OpCode::LOAD_LOCAL);
+    REQUIRE(inner[4].depth == 1);
+    REQUIRE(inner[4].arg == 2);
+    REQUIRE(inner[5].op == OpCode::TAIL_CALL);
+    REQUIRE(inner[2].arg == 6);
+}
+
+TEST_CASE("Calls share the copy of their argument syntax") {
+    constexpr int kDepth = 1000;
+    Heap heap;
+    Scope global_scope{&heap};
+    std::string source;
+    for (int i = 0; i < kDepth; ++i) {
+        source += "(f ";
+    }
+    source += "1" + std::string(kDepth, ')');
+    SyntaxArena arena;
+    Tokenizer tokenizer{std::string_view{source}};
+    Compiler compiler{&heap, &global_scope};
+    Code* code = compiler.Compile(Read(&tokenizer, &arena));
+    REQUIRE(CountOps(code, OpCode::APPLY_FORM) == kDepth);
+    // The code and the syntax copied once: the argument list of the outer call and two cells
+    // of every nested call
+    REQUIRE(heap.Size() == 2 * kDepth);
+}
+
+TEST_CASE("Bytecode VM agrees with the tree walker") {
+    std::vector<std::vector<std::string>> sessions = {
+        {"(+ 1 2)", "(- 1 #t)", "(/)", "(max 1 2 3)", "(abs -10)", "(abs 1 2)"},
+        {"(and)", "(or)", "(and 1 2 'c '(f g))", "(or #f 1)", "(or 1 #f)", "(and 1 #f 2)",
+         "(and #f (crash))", "(or #t (crash))", "(and . 1)"},
+        {"(if #t 0)", "(if #f 0)", "(if 1)", "(if)", "(if 1 2 3 4)", "(if #f 1 2)"},
+        {"'()", "'(1 2 . 3)", "(quote 1)", "'x", "(quote (quote 1))", "'(())"},
+        {"(())", "(1 2)", "('() ())", "(+ ())", "x", "(. 1)", "(+ 1 . 2)"},
+        {"(define x 1)", "(set! x (+ x 1))", "x", "(set! y 1)", "(define)", "(set! x 1 2)",
+         "(define x x)", "(define 1)"},
+        {"(define (f x) (if (= x 0) 0 (+ 1 (f (- x 1)))))", "(f 50)", "(f)", "(f 1 2)",
+         "f"},
+        {"(define (foo x) (define (bar) (set! x (+ (* x 2) 2)) x) bar)",
+         "(define my-foo (foo 20))", "(my-foo)", "(my-foo)"},
+        {"(lambda)", "(lambda x)", "(lambda (x))", "(lambda x 1)", "((lambda () 1))",
+         "((lambda (x y) (* x y)) 6 7)"},
+        {"(define x '(1 . 2))", "(set-car! x x)", "(cdr (car (car x)))", "(set-cdr! x)",
+         "(pair? '(1 2))", "(null? '())", "(list? '(1 . 2))", "(list 1 2 3)",
+         "(list-ref '(1 2 3) 1)", "(list-tail '(1 2 3) 1)", "(car '())", "(cons 1 2)"},
+        {"(define plus +)", "(define (+ x) (if (= x 0) 0 (plus 1 (+ (- x 1)))))", "(+ 8)",
+         "(+ 1 2)", "(define if 1)", "(if 1 2)"},
+        {"(define my-if if)", "(my-if #f 1 2)", "(define (g if) (if 1))", "(g not)"},
+        {"(define (g op) (op #t 1 2))", "(g if)", "(g and)", "(g quote)", "(g +)", "(g 1)",
+         "(define (f op x) (op (> x 0) (set! x (+ x 10)) 0) x)", "(f if 1)", "(f if -1)",
+         "(define (make op) (op (y) (* y 2)))", "((make lambda) 21)",
+         "(define (n op1 op2) (op1 (op2 #f 1 2) 3 4))", "(n if if)", "((if #t define 0) w 3)",
+         "w", "(define (s op) (op w 5))", "(s set!)", "w",
+         "(define (each ops) (if (null? ops) '() (cons ((car ops) #f 1 2) (each (cdr ops)))))",
+         "(each (list if and or if quote))"},
+        {"(define x 1)", "(define (f) (define y x) (define x 2) y)", "(f)",
+         "(define (g) (set! x 5) (define x 2) x)", "(g)", "x",
+         "(define (o a) (define (i) (define b a) (define a 3) (list a b)) (i))", "(o 7)"},
+        {"(define (h) (define a b) (define b 1) a)", "(h)", "(define (k x x) x)", "(k 1 2)",
+         "(define (s x) (set! y x))", "(s 1)", "(define y 0)", "(s 1)", "y"},
+    };
+    auto run_session = [](EvalMode eval_mode, const std::vector<std::string>& session) {
+        Interpreter interpreter{eval_mode};
+        std::vector<std::string> results;
+        for (const auto& expression : session) {
+            results.push_back(RunCatching(&interpreter, expression));
+        }
+        return results;
+    };
+    for (const auto& session : sessions) {
+        auto vm_results = run_session(EvalMode::BYTECODE, session);
+        auto tree_walker_results = run_session(EvalMode::TREE_WALK, session);
+        for (size_t i = 0; i < session.size(); ++i) {
+            INFO(session[i]);
+            REQUIRE(vm_results[i] == tree_walker_results[i]);
+        }
+    }
+}
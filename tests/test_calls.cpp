@@ -0,0 +1,99 @@
+#include <string>
+
+#include <catch.hpp>
+
+#include <allocations_checker.h>
+#include <parser.h>
+#include <scheme.h>
+
+namespace {
+
+// Tree walker over the builtins without the interpreter, so nothing but the calls allocates
+class BuiltinsScope {
+private:
+    Heap heap_;
+    Scope scope_;
+
+public:
+    BuiltinsScope()
+            : scope_(&heap_, {{Intern("+")->GetId(), heap_.Make<Add>(&heap_)},
+                              {Intern("-")->GetId(), heap_.Make<Sub>(&heap_)},
+                              {Intern("*")->GetId(), heap_.Make<Product>(&heap_)},
+                              {Intern("max")->GetId(), heap_.Make<Max>(&heap_)},
+                              {Intern("abs")->GetId(), heap_.Make<Abs>(&heap_)},
+                              {Intern("<")->GetId(), heap_.Make<Less>()},
+                              {Intern("=")->GetId(), heap_.Make<Equal>()},
+                              {Intern("not")->GetId(), heap_.Make<Not>()},
+                              {Intern("number?")->GetId(), heap_.Make<IsNumber>()},
+                              {Intern("pair?")->GetId(), heap_.Make<IsPair>()},
+                              {Intern("cons")->GetId(), heap_.Make<Cons>(&heap_)},
+                              {Intern("car")->GetId(), heap_.Make<Car>()},
+                              {Intern("cdr")->GetId(), heap_.Make<Cdr>()},
+                              {Intern("list")->GetId(), heap_.Make<List>(&heap_)},
+                              {Intern("list-ref")->GetId(), heap_.Make<ListRef>()},
+                              {Intern("list-tail")->GetId(), heap_.Make<ListTail>(&heap_)},
+                              {Intern("set-car!")->GetId(), heap_.Make<SetCar>(&heap_)},
+                              {Intern("if")->GetId(), heap_.Make<If>()},
+                              {Intern("and")->GetId(), heap_.Make<And>()},
+                              {Intern("quote")->GetId(), heap_.Make<Quote>()}}) {
+    }
+
+    Object* Read(const std::string& code) {
+        Tokenizer tokenizer{std::string_view{code}};
+        return ::Read(&tokenizer, &heap_);
+    }
+
+    Object* Eval(Object* expression) {
+        return expression->Eval(&scope_);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Calls of builtins don't allocate") {
+    BuiltinsScope scope;
+    Object* expression = scope.Read(
+        "(cons (list (+ 1 2 3) (- 10 (abs -4)) (* 2 (max 1 7 3)) (< 1 2 3) (= 1 1) (not #f))"
+        "      (list (number? 5) (pair? (cons 1 2)) (car (cons 1 2)) (cdr (list 1 2))"
+        "            (list-ref '(4 5 6) 2) (list-tail '(4 5 6) 1)"
+        "            (pair? (set-car! (list 1) 2)) (if (and (< 1 2) #t) 'yes 'no)))");
+    const std::string expected = "((6 6 14 #t #t #t) #t #t 1 (2) 6 (5 6) #f yes)";
+    REQUIRE(SerializeObject(scope.Eval(expression)) == expected);
+
+    // Results are allocated in the slabs of the heap, which are already there
+    Object* result = nullptr;
+    EXPECT_ZERO_ALLOCATIONS(for (int i = 0; i < 50; ++i) { result = scope.Eval(expression); });
+    REQUIRE(SerializeObject(result) == expected);
+}
+
+TEST_CASE("Calls with many arguments spill out of the inline buffer") {
+    constexpr int kCount = 3 * static_cast<int>(Procedure::kInlineArgsCount);
+    BuiltinsScope scope;
+    std::string args;
+    std::string list = "(1";
+    for (int i = 1; i <= kCount; ++i) {
+        args += ' ';
+        args += std::to_string(i);
+        if (i > 1) {
+            list += ' ';
+            list += std::to_string(i);
+        }
+    }
+    REQUIRE(SerializeObject(scope.Eval(scope.Read("(+" + args + ")"))) ==
+            std::to_string(kCount * (kCount + 1) / 2));
+    REQUIRE(SerializeObject(scope.Eval(scope.Read("(list" + args + ")"))) == list + ")");
+}
+
+TEST_CASE("Fixed arity fast paths check their arguments") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        REQUIRE(interpreter.Run("(- 7 2)") == "5");
+        REQUIRE(interpreter.Run("(< 2 1)") == "#f");
+        REQUIRE(interpreter.Run("(cons 1 2)") == "(1 . 2)");
+        REQUIRE(interpreter.Run("(car '(1 2))") == "1");
+        REQUIRE(interpreter.Run("(abs -2)") == "2");
+        REQUIRE_THROWS_AS(interpreter.Run("(+ 1 #t)"), RuntimeError);
+        REQUIRE_THROWS_AS(interpreter.Run("(< 'a 1)"), RuntimeError);
+        REQUIRE_THROWS_AS(interpreter.Run("(abs 'a)"), RuntimeError);
+    }
+}
@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scheme_test.h"
+
+#include <parser.h>
+
+#include <catch.hpp>
+
+namespace {
+
+std::string MakeTable(int size) {
+    std::string table = "'(";
+    for (int i = 0; i < size; ++i) {
+        table += std::to_string(i) + " ";
+    }
+    return table + ")";
+}
+
+}  // namespace
+
+TEST_CASE_METHOD(SchemeTest, "Minor collection doesn't trace the old generation") {
+    ExpectNoError("(define table " + MakeTable(1000) + ")");
+    // survivors are promoted after the second collection
+    ExpectEq("(+ 1 2)", "3");
+    ExpectEq("(+ 1 2)", "3");
+
+    size_t old_objects = GetHeap().GetOldCount();
+    ExpectEq("(+ 1 2)", "3");
+    REQUIRE(GetHeap().GetOldCount() == old_objects);
+    REQUIRE(GetHeap().GetNursery().empty());
+    REQUIRE(GetHeap().GetSurvivors().empty());
+    ExpectEq("(list-ref table 999)", "999");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Write barrier keeps young objects stored into old ones") {
+    ExpectNoError("(define x '(1 2 3))");
+    ExpectNoError("(define (make-counter) (define n 0) (lambda () (set! n (+ n 1)) n))");
+    ExpectNoError("(define counter (make-counter))");
+    ExpectEq("(counter)", "1");
+    ExpectEq("(+ 1 2)", "3");
+    ExpectEq("(+ 1 2)", "3");
+
+    ExpectNoError("(set-car! x (list 4 5))");
+    ExpectNoError("(set-cdr! (cdr x) (list 6))");
+    ExpectEq("(counter)", "2");
+    for (int i = 0; i < 3; ++i) {
+        ExpectEq("(+ 1 2)", "3");
+    }
+    ExpectEq("x", "((4 5) 2 6)");
+    ExpectEq("(counter)", "3");
+}
+
+TEST_CASE("Full collection keeps only objects reachable from the roots") {
+    Heap heap;
+    Scope scope{&heap};
+    scope.Define(Intern("x")->GetId(), heap.Make<Cell>(heap.Make<Number>(1), nullptr));
+    heap.Make<Cell>(heap.Make<Number>(2), nullptr);
+    Object* roots[] = {&scope};
+
+    // marks of the previous collection must not leak into the next one
+    for (int i = 0; i < 3; ++i) {
+        heap.Collect(roots, true);
+        REQUIRE(heap.GetOldCount() == 2);
+        REQUIRE(heap.GetNursery().empty());
+    }
+    scope.Define(Intern("x")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.GetOldCount() == 0);
+}
+
+TEST_CASE("Marking of a long list doesn't recurse") {
+    constexpr size_t kLength = 1'000'000;
+    Heap heap;
+    Scope scope{&heap};
+    Object* list = nullptr;
+    for (size_t i = 0; i < kLength; ++i) {
+        list = heap.Make<Cell>(nullptr, list);
+    }
+    scope.Define(Intern("list")->GetId(), list);
+    Object* roots[] = {&scope};
+
+    // young list is marked by the minor collection, old one by the full
+    heap.Collect(roots);
+    REQUIRE(heap.GetSurvivors().size() == kLength);
+    heap.Collect(roots, true);
+    REQUIRE(heap.GetOldCount() == kLength);
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.GetOldCount() == 0);
+}
+
+TEST_CASE("Syntax arena is released at once and promotion copies the syntax") {
+    constexpr int kDepth = 100'000;
+    SyntaxArena arena;
+    std::string source(kDepth, '(');
+    source += "1 . 4611686018427387904";
+    source += std::string(kDepth, ')');
+    Tokenizer tokenizer{std::string_view{source}};
+    Object* syntax = Read(&tokenizer, &arena);
+    REQUIRE(Heap::IsSyntax(syntax));
+    REQUIRE(arena.Size() == kDepth + 2);
+
+    Heap heap;
+    Object* node = heap.Promote(syntax);
+    arena.Reset();
+    REQUIRE(arena.Size() == 0);
+    // the arena memory is reused, so the copy must not refer to it
+    Tokenizer next_tokenizer{std::string_view{source}};
+    Read(&next_tokenizer, &arena);
+
+    // 1 is promoted to a fixnum
+    REQUIRE(heap.Size() == kDepth + 1);
+    for (int i = 0; i < kDepth - 1; ++i) {
+        node = As<Cell>(node)->GetFirst();
+    }
+    REQUIRE(!Heap::IsSyntax(node));
+    REQUIRE(GetNumeric(As<Cell>(node)->GetFirst()) == 1);
+    REQUIRE(Is<Number>(As<Cell>(node)->GetSecond()));
+    REQUIRE(SerializeObject(node) == "(1 . 4611686018427387904)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Constants outlive the syntax of their run") {
+    ExpectNoError("(define x '(1 (2 . 3) #t))");
+    ExpectNoError("(define (f) (list 4611686018427387904 'y '(5 6)))");
+    ExpectNoError("(define n 7)");
+    // the next runs overwrite the syntax arena
+    ExpectEq("(list 8 9 10 11 12 13 14 15 16 17)", "(8 9 10 11 12 13 14 15 16 17)");
+    ExpectEq("x", "(1 (2 . 3) #t)");
+    ExpectEq("(f)", "(4611686018427387904 y (5 6))");
+    ExpectEq("n", "7");
+}
+
+TEST_CASE("Run collects only when the heap is over its budget") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        Heap& heap = interpreter.GetHeap();
+        interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+        interpreter.Collect();
+        size_t live = heap.Size();
+        heap.ResetCollectorStats();
+
+        heap.SetCollectionBudget(2, 1000);
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+        }
+        REQUIRE(heap.GetCollectorStats().collections == 0);
+        REQUIRE(heap.Size() > live);
+
+        REQUIRE(interpreter.Run("(car (range 2000 '()))") == "1");
+        REQUIRE(heap.GetCollectorStats().collections > 0);
+        REQUIRE(heap.Size() < live + 1000);
+
+        // Budget 0 collects after every Run
+        heap.SetCollectionBudget(1, 0);
+        size_t collections = heap.GetCollectorStats().collections;
+        REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+        REQUIRE(heap.GetCollectorStats().collections == collections + 1);
+    }
+}
+
+TEST_CASE("Tree walker collects the scopes of tail loops") {
+    Interpreter interpreter{EvalMode::TREE_WALK};
+    Heap& heap = interpreter.GetHeap();
+    interpreter.Run("(define (loop n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1))))");
+    interpreter.Collect();
+    heap.ResetCollectorStats();
+
+    // Every iteration allocates a scope and numbers, the loop makes more than a million objects
+    REQUIRE(interpreter.Run("(loop 300000 0)") == "300000");
+    REQUIRE(heap.GetCollectorStats().collections > 0);
+    REQUIRE(heap.GetCollectorStats().peak_size < 300'000);
+
+    // Values held by the evaluations around the loop survive its collections
+    REQUIRE(interpreter.Run("(+ (car (list (loop 100000 0))) (loop 100000 1))") == "200001");
+    interpreter.Run("(define (f n) (define xs (list 1 2)) (define total (loop n 0)) "
+                    "(+ total (car (cdr xs))))");
+    REQUIRE(interpreter.Run("(f 100000)") == "100002");
+    REQUIRE(interpreter.Run("((lambda (x) (loop 100000 0) x) (list 7 8))") == "(7 8)");
+}
+
+TEST_CASE("Explicit collection releases all garbage") {
+    Interpreter interpreter;
+    interpreter.Run("(define x (list 1 2 3))");
+    interpreter.Collect();
+    size_t live = interpreter.GetHeap().Size();
+    for (int i = 0; i < 100; ++i) {
+        interpreter.Run("(list 4 5 6)");
+    }
+    REQUIRE(interpreter.GetHeap().Size() > live);
+    interpreter.Collect();
+    REQUIRE(interpreter.GetHeap().Size() == live);
+    REQUIRE(interpreter.Run("x") == "(1 2 3)");
+}
+
+namespace {
+
+size_t ListLength(Object* list) {
+    size_t length = 0;
+    for (; list; list = As<Cell>(list)->GetSecond()) {
+        ++length;
+    }
+    return length;
+}
+
+std::string MakeList(int length) {
+    std::string list = "(";
+    for (int i = 0; i < length; ++i) {
+        list += std::to_string(i) + " ";
+    }
+    return list + ")";
+}
+
+// Cycle over old garbage, which is swept by a few steps
+void StartCycleOverGarbage(Heap* heap, Scope* scope, std::span<Object* const> roots) {
+    constexpr int kGarbageLength = 5'000;
+    Object* garbage = nullptr;
+    for (int i = 0; i < kGarbageLength; ++i) {
+        garbage = heap->Make<Cell>(nullptr, garbage);
+    }
+    scope->Define(Intern("garbage")->GetId(), garbage);
+    heap->Collect(roots);
+    heap->Collect(roots);
+    scope->Define(Intern("garbage")->GetId(), nullptr);
+    heap->Collect(roots);
+    REQUIRE(heap->IsCollecting());
+}
+
+}  // namespace
+
+TEST_CASE("Incremental cycle keeps the snapshot and the objects allocated during it") {
+    constexpr int kLength = 20'000;
+    Heap heap;
+    heap.SetStepBudget(100, std::chrono::seconds{1});
+    Scope scope{&heap};
+    Object* roots[] = {&scope};
+    Object* list = nullptr;
+    Object* garbage = nullptr;
+    Cell* middle = nullptr;
+    for (int i = 0; i < kLength; ++i) {
+        list = heap.Make<Cell>(nullptr, list);
+        if (i == kLength / 2) {
+            middle = As<Cell>(list);
+        }
+        garbage = heap.Make<Cell>(nullptr, garbage);
+    }
+    scope.Define(Intern("list")->GetId(), list);
+    scope.Define(Intern("garbage")->GetId(), garbage);
+    // promoted after the second minor collection, the next major one starts the cycle
+    heap.Collect(roots);
+    heap.Collect(roots);
+    REQUIRE(heap.GetOldCount() == 2 * kLength);
+    scope.Define(Intern("garbage")->GetId(), nullptr);
+    heap.Collect(roots);
+    REQUIRE(heap.IsCollecting());
+
+    // The tail is moved into a new cell before the marking reaches it, only the barrier
+    // on the overwritten reference keeps it alive
+    Cell* moved = heap.Make<Cell>(middle->GetSecond(), nullptr);
+    scope.Define(Intern("moved")->GetId(), moved);
+    heap.PreWriteBarrier(middle->GetSecond());
+    middle->SetTail(nullptr);
+    heap.WriteBarrier(middle, nullptr);
+
+    size_t steps = 0;
+    while (heap.IsCollecting()) {
+        heap.Make<Cell>(nullptr, nullptr);  // garbage allocated during the cycle
+        heap.Step();
+        ++steps;
+    }
+    REQUIRE(steps > 10);
+    REQUIRE(ListLength(list) == kLength / 2);
+    REQUIRE(ListLength(As<Cell>(moved)->GetFirst()) == kLength / 2);
+    // The old garbage is swept, the cells allocated during the cycle are old and wait
+    // for the next major collection
+    REQUIRE(heap.GetOldCount() == kLength + 1 + steps);
+
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == kLength + 1);
+    scope.Define(Intern("list")->GetId(), nullptr);
+    scope.Define(Intern("moved")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == 0);
+}
+
+TEST_CASE("Allocations of a promotion don't end the cycle") {
+    constexpr int kLength = 50'000;
+    Heap heap;
+    heap.SetStepBudget(1024, std::chrono::seconds{1});
+    Scope scope{&heap};
+    Object* roots[] = {&scope};
+    StartCycleOverGarbage(&heap, &scope, roots);
+
+    std::string source = MakeList(kLength);
+    SyntaxArena arena;
+    Tokenizer tokenizer{std::string_view{source}};
+    Object* syntax = Read(&tokenizer, &arena);
+    // The steps in the Makes sweep all slabs, the copy is allocated black into the old
+    // generation until the next Collect ends the cycle
+    Object* copy = heap.Promote(syntax);
+    REQUIRE(heap.IsCycleSwept());
+    REQUIRE(heap.GetOldCount() == static_cast<size_t>(kLength));
+    arena.Reset();
+
+    scope.Define(Intern("copy")->GetId(), copy);
+    heap.Collect(roots);
+    REQUIRE(!heap.IsCollecting());
+    heap.Collect(roots);
+    REQUIRE(heap.Size() == static_cast<size_t>(kLength));
+    REQUIRE(ListLength(copy) == static_cast<size_t>(kLength));
+    REQUIRE(GetNumeric(As<Cell>(copy)->GetFirst()) == 0);
+
+    scope.Define(Intern("copy")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == 0);
+}
+
+TEST_CASE("Lists built during the end of a cycle survive the next minor collection") {
+    constexpr int kLength = 40'000;
+    constexpr int kTailLength = 10'000;
+    Heap heap;
+    heap.SetStepBudget(1 << 16, std::chrono::seconds{1});
+    Scope scope{&heap};
+    Object* roots[] = {&scope};
+    ListTail list_tail{&heap};
+
+    SECTION("Read to the heap") {
+        StartCycleOverGarbage(&heap, &scope, roots);
+        const std::string source = MakeList(kLength);
+        Tokenizer tokenizer{std::string_view{source}};
+        scope.Define(Intern("list")->GetId(), Read(&tokenizer, &heap));
+        REQUIRE(heap.IsCycleSwept());
+    }
+    SECTION("list-tail") {
+        const std::string source = MakeList(kTailLength);
+        Tokenizer tokenizer{std::string_view{source}};
+        scope.Define(Intern("list")->GetId(), Read(&tokenizer, &heap));
+        StartCycleOverGarbage(&heap, &scope, roots);
+        Object* args[] = {*scope.Lookup(Intern("list")->GetId()), MakeNumber(&heap, 0)};
+        scope.Define(Intern("list")->GetId(), list_tail.CallWith(args));
+        REQUIRE(heap.IsCycleSwept());
+    }
+    heap.Collect(roots);
+    REQUIRE(!heap.IsCollecting());
+    heap.Collect(roots);
+    Object* list = *scope.Lookup(Intern("list")->GetId());
+    const size_t length = ListLength(list);
+    REQUIRE((length == kLength || length == kTailLength));
+    REQUIRE(GetNumeric(As<Cell>(list)->GetFirst()) == 0);
+    // Read makes Number objects, the copy of list-tail shares them
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == 2 * length);
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == 0);
+}
+
+TEST_CASE("Concurrent cycle keeps the snapshot") {
+    constexpr int kLength = 100'000;
+    Heap heap;
+    heap.SetConcurrent(true);
+    heap.SetStepBudget(16, std::chrono::seconds{1});
+    Scope scope{&heap};
+    Object* roots[] = {&scope};
+    Object* list = nullptr;
+    Object* garbage = nullptr;
+    for (int i = 0; i < kLength; ++i) {
+        list = heap.Make<Cell>(nullptr, list);
+        garbage = heap.Make<Cell>(nullptr, garbage);
+    }
+    scope.Define(Intern("list")->GetId(), list);
+    scope.Define(Intern("garbage")->GetId(), garbage);
+    heap.Collect(roots);
+    heap.Collect(roots);
+    scope.Define(Intern("garbage")->GetId(), nullptr);
+    heap.Collect(roots);
+    REQUIRE(heap.IsCollecting());
+
+    // The mutator cuts the list in pieces and links them back while the marker runs
+    std::vector<Cell*> cells;
+    for (Object* cell = list; cell; cell = As<Cell>(cell)->GetSecond()) {
+        cells.push_back(As<Cell>(cell));
+    }
+    size_t allocated_count = 0;
+    for (int round = 0; heap.IsCollecting(); ++round) {
+        Cell* cut = cells[(round * 7919) % (kLength - 1)];
+        Object* tail = cut->GetSecond();
+        Cell* holder = heap.Make<Cell>(tail, nullptr);
+        ++allocated_count;
+        scope.Define(Intern("holder")->GetId(), holder);
+        heap.PreWriteBarrier(tail);
+        cut->SetTail(nullptr);
+        heap.Step();
+        cut->SetTail(tail);
+        holder->SetHead(nullptr);
+    }
+    REQUIRE(ListLength(list) == kLength);
+    REQUIRE(heap.GetOldCount() == kLength + allocated_count);
+
+    scope.Define(Intern("holder")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == kLength);
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect(roots, true);
+    REQUIRE(heap.Size() == 0);
+}
+
+TEST_CASE("Mutations during incremental cycles") {
+    for (auto [eval_mode, is_concurrent] :
+         {std::pair{EvalMode::BYTECODE, false}, std::pair{EvalMode::TREE_WALK, false},
+          std::pair{EvalMode::BYTECODE, true}, std::pair{EvalMode::TREE_WALK, true}}) {
+        Interpreter interpreter{eval_mode};
+        Heap& heap = interpreter.GetHeap();
+        heap.SetStepBudget(64, std::chrono::seconds{1});
+        heap.SetConcurrent(is_concurrent);
+        interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+        interpreter.Run("(define (sum l acc) (if (null? l) acc (sum (cdr l) (+ acc (car l)))))");
+        interpreter.Run("(define (last l) (if (null? (cdr l)) l (last (cdr l))))");
+        interpreter.Run("(define table (range 5000 '()))");
+        interpreter.Run("(define spare '())");
+        for (int i = 0; i < 200; ++i) {
+            // the tail of table is moved between the variables and back
+            interpreter.Run("(set! spare (cdr (cdr table)))");
+            interpreter.Run("(set-cdr! (cdr table) '())");
+            interpreter.Run("(range 1000 '())");
+            interpreter.Run("(set-cdr! (cdr table) spare)");
+            interpreter.Run("(set! spare (list spare))");
+            interpreter.Run("(set-car! table (car (last table)))");
+            REQUIRE(interpreter.Run("(sum table 0)") == "12507499");
+        }
+        REQUIRE(heap.GetCollectorStats().cycles > 0);
+        interpreter.Collect();
+        REQUIRE(interpreter.Run("(sum table 0)") == "12507499");
+    }
+}
+
+TEST_CASE("Parallel collections keep the same objects") {
+    size_t single_thread_size = 0;
+    for (size_t threads_count : {1, 2, 4, 8}) {
+        Interpreter interpreter{EvalMode::BYTECODE};
+        Heap& heap = interpreter.GetHeap();
+        heap.SetCollectorThreads(threads_count);
+        interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+        interpreter.Run("(define (tree depth) (if (= depth 0) '() "
+                        "(cons (tree (- depth 1)) (tree (- depth 1)))))");
+        interpreter.Run("(define (leaves t) (if (null? t) 1 "
+                        "(+ (leaves (car t)) (leaves (cdr t)))))");
+        interpreter.Run("(define t (tree 14))");
+        interpreter.Run("(define l (range 20000 '()))");
+        for (int i = 0; i < 5; ++i) {
+            interpreter.Run("(range 50000 '())");
+            interpreter.Collect();
+        }
+        if (threads_count == 1) {
+            single_thread_size = heap.Size();
+        }
+        REQUIRE(heap.Size() == single_thread_size);
+        REQUIRE(interpreter.Run("(leaves t)") == "16384");
+        REQUIRE(interpreter.Run("(list-ref l 19999)") == "20000");
+    }
+}
+
+TEST_CASE("Compaction puts the cells of a list in a row") {
+    constexpr int kLength = 10'000;
+    Heap heap;
+    Scope scope{&heap};
+    std::vector<Cell*> cells;
+    for (int i = 0; i < kLength; ++i) {
+        cells.push_back(heap.Make<Cell>(MakeNumber(&heap, i), nullptr));
+    }
+    // Linked in a random order, as a list built from the reused slots
+    std::vector<Cell*> order = cells;
+    std::shuffle(order.begin(), order.end(), std::mt19937{42});
+    std::vector<Object*> values;
+    for (int i = 0; i < kLength; ++i) {
+        order[i]->SetTail(i + 1 < kLength ? order[i + 1] : nullptr);
+        values.push_back(order[i]->GetFirst());
+    }
+    scope.Define(Intern("list")->GetId(), order.front());
+    std::vector<Object**> root_slots;
+    scope.TraceSlots(&root_slots);
+    heap.CompactCells(root_slots);
+
+    REQUIRE(heap.Size() == static_cast<size_t>(kLength));
+    Object* list = *scope.Lookup(Intern("list")->GetId());
+    size_t adjacent_count = 0;
+    size_t index = 0;
+    for (Object* cell = list; cell; cell = As<Cell>(cell)->GetSecond(), ++index) {
+        REQUIRE(As<Cell>(cell)->GetFirst() == values[index]);
+        Object* next = As<Cell>(cell)->GetSecond();
+        adjacent_count += next && reinterpret_cast<uintptr_t>(next) -
+                                          reinterpret_cast<uintptr_t>(cell) ==
+                                      sizeof(Cell);
+    }
+    REQUIRE(index == static_cast<size_t>(kLength));
+    // Only the ends of the slabs break the row
+    REQUIRE(adjacent_count > kLength * 99 / 100);
+
+    scope.Define(Intern("list")->GetId(), nullptr);
+    heap.Collect({}, true);
+    REQUIRE(heap.Size() == 0);
+}
+
+TEST_CASE("Compaction keeps the values and the sharing of the cells") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.SetParseCacheCapacity(4);
+        interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+        interpreter.Run("(define a (list 1 2 3))");
+        interpreter.Run("(define b (cons 0 a))");
+        interpreter.Run("(define nested (list a (list 4 (list 5 6)) '(7 . 8)))");
+        interpreter.Run("(define (make-getter l) (lambda (i) (list-ref l i)))");
+        interpreter.Run("(define get (make-getter (range 1000 '())))");
+        interpreter.Run("(define (constant) '(9 10 11))");
+        interpreter.Run("(range 5000 '())");
+        REQUIRE(interpreter.Run("'(12 (13 14))") == "(12 (13 14))");
+
+        interpreter.Compact();
+        REQUIRE(interpreter.Run("b") == "(0 1 2 3)");
+        REQUIRE(interpreter.Run("nested") == "((1 2 3) (4 (5 6)) (7 . 8))");
+        REQUIRE(interpreter.Run("(get 999)") == "1000");
+        REQUIRE(interpreter.Run("(constant)") == "(9 10 11)");
+        REQUIRE(interpreter.Run("'(12 (13 14))") == "(12 (13 14))");
+        // a is still shared by b and nested
+        interpreter.Run("(set-car! a 42)");
+        REQUIRE(interpreter.Run("(car (cdr b))") == "42");
+        REQUIRE(interpreter.Run("(car (car nested))") == "42");
+
+        interpreter.Compact();
+        interpreter.Collect();
+        REQUIRE(interpreter.Run("b") == "(0 42 2 3)");
+        REQUIRE(interpreter.Run("(get 0)") == "1");
+    }
+}
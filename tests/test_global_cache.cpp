@@ -0,0 +1,67 @@
+#include <catch.hpp>
+
+#include <scheme.h>
+
+TEST_CASE("Cached globals see define and set!") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.Run("(define (f x) (+ x 1))");
+        interpreter.Run("(define (g) (f 1))");
+        REQUIRE(interpreter.Run("(g)") == "2");
+        interpreter.Run("(define (f x) (* x 10))");
+        REQUIRE(interpreter.Run("(g)") == "10");
+        interpreter.Run("(set! f (lambda (x) (- 0 x)))");
+        REQUIRE(interpreter.Run("(g)") == "-1");
+        interpreter.Run("(set! + *)");
+        REQUIRE(interpreter.Run("(+ 2 3)") == "6");
+    }
+}
+
+TEST_CASE("Cached globals are shadowed by nearer bindings") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.Run("(define (sum a b) (+ a b))");
+        REQUIRE(interpreter.Run("(sum 1 2)") == "3");
+        interpreter.Run("(define (apply-op + a b) (+ a b))");
+        REQUIRE(interpreter.Run("(apply-op - 1 2)") == "-1");
+        interpreter.Run("(define (first-of-tail l) (define car cdr) (car l))");
+        REQUIRE(interpreter.Run("(first-of-tail '(1 2))") == "(2)");
+        // Shadowing is lexical, the global bindings are still there
+        REQUIRE(interpreter.Run("(sum 1 2)") == "3");
+        REQUIRE(interpreter.Run("(car '(1 2))") == "1");
+    }
+}
+
+TEST_CASE("Tree walker drops the cached global after a nearer define") {
+    Interpreter interpreter{EvalMode::TREE_WALK};
+    interpreter.Run("(define (g) 1)");
+    interpreter.Run("(define (f) (define r (g)) (define (g) 2) (list r (g)))");
+    REQUIRE(interpreter.Run("(f)") == "(1 2)");
+    REQUIRE(interpreter.Run("(g)") == "1");
+}
+
+TEST_CASE("Unbound globals aren't cached") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.Run("(define (f) (g))");
+        REQUIRE_THROWS_AS(interpreter.Run("(f)"), NameError);
+        interpreter.Run("(define (g) 7)");
+        REQUIRE(interpreter.Run("(f)") == "7");
+    }
+}
+
+TEST_CASE("Global caches count hits and misses") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+        interpreter.ResetGlobalCacheStats();
+        REQUIRE(interpreter.Run("(fib 15)") == "610");
+        GlobalCacheStats stats = interpreter.GetGlobalCacheStats();
+        // fib, <, + and - are looked up once per site, n is a local variable
+        REQUIRE(stats.hits > 1000);
+        REQUIRE(stats.misses <= 7);
+        REQUIRE(stats.GetHitRatio() > 0.99);
+        interpreter.ResetGlobalCacheStats();
+        REQUIRE(interpreter.GetGlobalCacheStats().hits == 0);
+    }
+}
@@ -112,3 +112,30 @@ TEST_CASE_METHOD(SchemeTest, "IntegerAbsEdgeCases") {
     ExpectRuntimeError("(abs #t)");
     ExpectRuntimeError("(abs 1 2)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "IntegersOutOfFixnumRange") {
+    // 2^62 - 1 is the largest immediate integer, larger ones are boxed
+    ExpectEq("(+ 4611686018427387903 1)", "4611686018427387904");
+    ExpectEq("(- (+ 4611686018427387903 1) 1)", "4611686018427387903");
+    ExpectEq("(- 0 4611686018427387904 1)", "-4611686018427387905");
+    ExpectEq("(= (* 4611686018427387904 1) (+ 4611686018427387903 1))", "#t");
+    ExpectEq("(number? (* 2305843009213693952 2))", "#t");
+    ExpectEq("(list (+ 1 2) (* 2305843009213693952 2))", "(3 4611686018427387904)");
+}
+
+TEST_CASE("Arithmetic on small integers doesn't allocate") {
+    Heap heap;
+    Add add{&heap};
+    Less less;
+    Object* args[] = {MakeNumber(&heap, 40), MakeNumber(&heap, 2)};
+
+    alloc_checker::ResetCounters();
+    Object* sum = add.Call(args);
+    Object* is_less = less.Call(args);
+    REQUIRE(alloc_checker::AllocCount() == 0);
+    REQUIRE(heap.Size() == 0);
+
+    REQUIRE(IsFixnum(sum));
+    REQUIRE(GetNumeric(sum) == 42);
+    REQUIRE(is_less == Bool::Get(false));
+}
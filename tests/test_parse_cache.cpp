@@ -0,0 +1,83 @@
+#include <string>
+
+#include <catch.hpp>
+
+#include <allocations_checker.h>
+#include <scheme.h>
+
+TEST_CASE("Parse cache is disabled by default") {
+    Interpreter interpreter;
+    REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    REQUIRE(interpreter.Run("(+ 1 2)") == "3");
+    REQUIRE(interpreter.GetParseCache().GetHits() == 0);
+    REQUIRE(interpreter.GetParseCache().GetMisses() == 0);
+}
+
+TEST_CASE("Parse cache counts hits and misses") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.SetParseCacheCapacity(2);
+        interpreter.Run("(define (inc x) (+ x 1))");
+        interpreter.Run("(define n 0)");
+        for (int i = 1; i <= 100; ++i) {
+            // the cached expressions survive collections after every run
+            REQUIRE(interpreter.Run("(set! n (inc n))") == "()");
+            REQUIRE(interpreter.Run("n") == std::to_string(i));
+        }
+        const ParseCache& cache = interpreter.GetParseCache();
+        REQUIRE(cache.GetMisses() == 4);
+        REQUIRE(cache.GetHits() == 198);
+        REQUIRE(cache.GetSize() == 2);
+    }
+}
+
+TEST_CASE("Parse cache evicts the least recently used source") {
+    Interpreter interpreter;
+    interpreter.SetParseCacheCapacity(2);
+    interpreter.Run("1");
+    interpreter.Run("2");
+    interpreter.Run("1");
+    interpreter.Run("3");  // evicts 2
+    interpreter.Run("1");
+    REQUIRE(interpreter.GetParseCache().GetHits() == 2);
+    interpreter.Run("2");
+    REQUIRE(interpreter.GetParseCache().GetMisses() == 4);
+
+    interpreter.SetParseCacheCapacity(1);
+    REQUIRE(interpreter.GetParseCache().GetSize() == 1);
+    interpreter.Run("2");
+    REQUIRE(interpreter.GetParseCache().GetHits() == 3);
+}
+
+TEST_CASE("Quoted pairs aren't shared by runs") {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.SetParseCacheCapacity(16);
+        interpreter.Run("(define x '(1 2))");
+        interpreter.Run("(set-car! x 5)");
+        REQUIRE(interpreter.Run("x") == "(5 2)");
+        interpreter.Run("(define x '(1 2))");
+        REQUIRE(interpreter.Run("x") == "(1 2)");
+        // only x is shared
+        REQUIRE(interpreter.GetParseCache().GetHits() == 1);
+        REQUIRE(interpreter.GetParseCache().GetSize() == 2);
+    }
+}
+
+TEST_CASE("Parse cache hits don't allocate") {
+    Interpreter interpreter;
+    interpreter.SetParseCacheCapacity(16);
+    const std::string code = "(if (< 1 2) 'a 'b)";
+    REQUIRE(interpreter.Run(code) == "a");
+    interpreter.Collect();
+
+    alloc_checker::ResetCounters();
+    size_t misses = interpreter.GetParseCache().GetMisses();
+    for (int i = 0; i < 100; ++i) {
+        interpreter.Run(code);
+    }
+    REQUIRE(interpreter.GetParseCache().GetMisses() == misses);
+    // The compiled code is garbage
+    interpreter.Collect();
+    REQUIRE(alloc_checker::AllocCount() == alloc_checker::DeallocCount());
+}
@@ -1,15 +1,22 @@
 #include <catch.hpp>
 
 #include <sstream>
+#include <string>
 
 #include <error.h>
 #include <parser.h>
 
+namespace {
+
+Heap heap;
+
+}  // namespace
+
 auto ReadFull(const std::string& str) {
     std::stringstream ss{str};
     Tokenizer tokenizer{&ss};
 
-    auto obj = Read(&tokenizer);
+    auto obj = Read(&tokenizer, &heap);
     REQUIRE(tokenizer.IsEnd());
     return obj;
 }
@@ -51,6 +58,21 @@ TEST_CASE("Read symbol") {
     }
 }
 
+TEST_CASE("Symbols are interned") {
+    auto list = ReadFull("(foo bar foo 'bar)");
+    std::vector<Object*> symbols = GetVectorFromCell(list, nullptr, false);
+    REQUIRE(symbols.size() == 4);
+    REQUIRE(symbols[0] == symbols[2]);
+    REQUIRE(symbols[0] != symbols[1]);
+    REQUIRE(As<Symbol>(symbols[0])->GetId() != As<Symbol>(symbols[1])->GetId());
+    REQUIRE(As<Cell>(symbols[3])->GetFirst() == Intern("quote"));
+    REQUIRE(As<Cell>(symbols[3])->GetSecond() == symbols[1]);
+
+    size_t heap_size = heap.Size();
+    REQUIRE(ReadFull("foo") == symbols[0]);
+    REQUIRE(heap.Size() == heap_size);
+}
+
 TEST_CASE("Lists") {
     SECTION("Empty list") {
         auto null = ReadFull("()");
@@ -154,3 +176,58 @@ TEST_CASE("Invalid") {
     REQUIRE_THROWS_AS(ReadFull("(1 . )"), SyntaxError);
     REQUIRE_THROWS_AS(ReadFull("(1 . 2 3)"), SyntaxError);
 }
+
+TEST_CASE("Long and deep lists don't use the C++ stack") {
+    SECTION("Long list") {
+        constexpr int kLength = 300'000;
+        std::string source = "'(";
+        for (int i = 0; i < kLength; ++i) {
+            source += std::to_string(i) + " ";
+        }
+        source += ". end)";
+        Tokenizer tokenizer{std::string_view{source}};
+        Object* node = As<Cell>(Read(&tokenizer, &heap))->GetSecond();
+        REQUIRE(tokenizer.IsEnd());
+
+        int length = 0;
+        for (; Is<Cell>(node) && As<Number>(As<Cell>(node)->GetFirst())->GetValue() == length;
+             node = As<Cell>(node)->GetSecond()) {
+            ++length;
+        }
+        REQUIRE(length == kLength);
+        REQUIRE(As<Symbol>(node)->GetName() == "end");
+    }
+
+    SECTION("Deep list") {
+        constexpr int kDepth = 2'000'000;
+        std::string source(kDepth, '(');
+        source += "x";
+        source += std::string(kDepth, ')');
+        Tokenizer tokenizer{std::string_view{source}};
+        Object* node = Read(&tokenizer, &heap);
+        REQUIRE(tokenizer.IsEnd());
+
+        int depth = 0;
+        for (; Is<Cell>(node) && !As<Cell>(node)->GetSecond(); node = As<Cell>(node)->GetFirst()) {
+            ++depth;
+        }
+        REQUIRE(depth == kDepth);
+        REQUIRE(As<Symbol>(node)->GetName() == "x");
+    }
+
+    SECTION("Deep quotes") {
+        constexpr int kDepth = 1'000'000;
+        std::string source(kDepth, '\'');
+        source += "()";
+        Tokenizer tokenizer{std::string_view{source}};
+        Object* node = Read(&tokenizer, &heap);
+
+        int depth = 0;
+        for (; Is<Cell>(node) && As<Cell>(node)->GetFirst() == Intern("quote");
+             node = As<Cell>(node)->GetSecond()) {
+            ++depth;
+        }
+        REQUIRE(depth == kDepth);
+        REQUIRE(!node);
+    }
+}
@@ -0,0 +1,52 @@
+#include <string>
+
+#include "scheme_test.h"
+
+#include <catch.hpp>
+
+namespace {
+
+// Deep enough to overflow the C++ stack of the tree walker without tail calls
+constexpr int kIterations = 100'000;
+
+void ExpectInBothModes(const std::string& definition, const std::string& expression,
+                       const std::string& result) {
+    for (EvalMode eval_mode : {EvalMode::BYTECODE, EvalMode::TREE_WALK}) {
+        Interpreter interpreter{eval_mode};
+        interpreter.Run(definition);
+        REQUIRE(interpreter.Run(expression) == result);
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Tail call in if branch") {
+    ExpectInBothModes("(define (loop n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1))))",
+                      "(loop " + std::to_string(kIterations) + " 0)",
+                      std::to_string(kIterations));
+}
+
+TEST_CASE("Tail call in the last argument of and/or") {
+    ExpectInBothModes("(define (all-positive n) (or (= n 0) (and (> n 0) (all-positive (- n 1)))))",
+                      "(all-positive " + std::to_string(kIterations) + ")", "#t");
+}
+
+TEST_CASE("Mutual tail recursion") {
+    ExpectInBothModes(
+        "(define (my-even? n) (define (my-odd? n) (if (= n 0) #f (my-even? (- n 1)))) "
+        "(if (= n 0) #t (my-odd? (- n 1))))",
+        "(my-even? " + std::to_string(kIterations + 1) + ")", "#f");
+}
+
+TEST_CASE("Tail call in the last body form") {
+    ExpectInBothModes("(define (count n) (define next (- n 1)) (if (< next 0) n (count next)))",
+                      "(count " + std::to_string(kIterations) + ")", "0");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Non tail calls keep their result") {
+    ExpectNoError("(define (f x) (if (= x 0) 0 (+ 1 (f (- x 1)))))");
+    ExpectEq("(f 100)", "100");
+    ExpectNoError("(define (g x) (and (f x) (or #f (f x))))");
+    ExpectEq("(g 10)", "10");
+    ExpectRuntimeError("((lambda () ()))");
+}
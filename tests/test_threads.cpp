@@ -0,0 +1,51 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <scheme.h>
+
+namespace {
+
+constexpr int kThreadsCount = 8;
+constexpr int kRunsCount = 200;
+
+// Catch assertions aren't thread safe, so workers only return what the main thread checks
+std::string Work(int thread_index) {
+    Interpreter interpreter{thread_index % 2 ? EvalMode::TREE_WALK : EvalMode::BYTECODE};
+    const std::string suffix = std::to_string(thread_index);
+    interpreter.Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+    interpreter.Run("(define table-" + suffix + " (range 1000 '()))");
+    std::string result;
+    for (int i = 0; i < kRunsCount; ++i) {
+        // new symbols are interned by all threads at the same time
+        const std::string name = "x-" + suffix + "-" + std::to_string(i);
+        interpreter.Run("(define " + name + " (list " + std::to_string(i) + " (fib 10)))");
+        interpreter.Run("(set-car! table-" + suffix + " " + name + ")");
+        result = interpreter.Run("(list (car table-" + suffix + ") (list-ref table-" + suffix +
+                                 " 999) (* " + suffix + " 1000000000000000000))");
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("Interpreters of different threads don't interfere") {
+    std::vector<std::string> results(kThreadsCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadsCount; ++i) {
+        threads.emplace_back([&results, i] { results[i] = Work(i); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < kThreadsCount; ++i) {
+        // numbers of the last threads don't fit into fixnums, so they are boxed
+        std::string big_number = std::to_string(1'000'000'000'000'000'000LL * i);
+        REQUIRE(results[i] == "((" + std::to_string(kRunsCount - 1) + " 55) 1000 " + big_number +
+                                  ")");
+    }
+}
@@ -4,6 +4,8 @@
 #include <tokenizer.h>
 
 #include <sstream>
+#include <string>
+#include <vector>
 
 TEST_CASE("Tokenizer works on simple case") {
     std::stringstream ss{"4+)'."};
@@ -153,3 +155,86 @@ TEST_CASE("Empty string handled correctly") {
 
     REQUIRE(tokenizer.IsEnd());
 }
+
+TEST_CASE("Tokenizer over a buffer refers to the source") {
+    std::string source = "(define x1 +12)'#t . -3";
+    Tokenizer tokenizer{std::string_view{source}};
+
+    REQUIRE(tokenizer.GetToken() == Token{BracketToken::OPEN});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"define"}});
+    REQUIRE(std::get<SymbolToken>(tokenizer.GetToken()).name.data() == source.data() + 1);
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"x1"}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{ConstantToken{12}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{BracketToken::CLOSE});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{QuoteToken{}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{BooleanToken{true}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{DotToken{}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{ConstantToken{-3}});
+    tokenizer.Next();
+    REQUIRE(tokenizer.IsEnd());
+}
+
+TEST_CASE("Numbers out of range are syntax errors") {
+    std::string source = "99999999999999999999";
+    std::stringstream ss{source};
+    REQUIRE_THROWS_AS(Tokenizer{&ss}, SyntaxError);
+    REQUIRE_THROWS_AS(Tokenizer{std::string_view{source}}, SyntaxError);
+}
+
+namespace {
+
+// Symbols of the stream tokenizer are valid until Next, so tokens are copied into strings
+std::vector<std::string> ReadAll(Tokenizer* tokenizer) {
+    std::vector<std::string> tokens;
+    for (; !tokenizer->IsEnd(); tokenizer->Next()) {
+        const Token& token = tokenizer->GetToken();
+        std::string text = std::to_string(token.index()) + ":";
+        if (auto symbol = std::get_if<SymbolToken>(&token)) {
+            text += symbol->name;
+        } else if (auto constant = std::get_if<ConstantToken>(&token)) {
+            text += std::to_string(constant->value);
+        } else if (auto boolean = std::get_if<BooleanToken>(&token)) {
+            text += boolean->state ? "t" : "f";
+        } else if (auto bracket = std::get_if<BracketToken>(&token)) {
+            text += *bracket == BracketToken::OPEN ? "(" : ")";
+        }
+        tokens.push_back(text);
+    }
+    return tokens;
+}
+
+}  // namespace
+
+TEST_CASE("Structural scanner gives the same tokens at every SIMD level") {
+    // atoms and runs of spaces cross the 64 bytes blocks
+    std::string source = "(define (f x)\n\t(if (< x -12) '(a . b) (list x #t #f)))(a#b #t)(#f)" +
+                         std::string(100, ' ') + "long-symbol-" + std::string(70, 'z') +
+                         "+12 12345678901234 abc+def" + std::string(63, '\n') + "'last";
+    std::stringstream ss{source};
+    Tokenizer stream_tokenizer{&ss};
+    std::vector<std::string> expected = ReadAll(&stream_tokenizer);
+    REQUIRE(expected.size() == 41);
+
+    SimdLevel previous_level = GetSimdLevel();
+    for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2}) {
+        SetSimdLevel(level);
+        // every prefix ends the source at a different offset of the last block
+        for (size_t size : {source.size(), source.size() - 1, source.size() - 5}) {
+            std::string_view prefix{source.data(), size};
+            std::stringstream prefix_stream{std::string{prefix}};
+            Tokenizer prefix_stream_tokenizer{&prefix_stream};
+            Tokenizer tokenizer{prefix};
+            REQUIRE(ReadAll(&tokenizer) == ReadAll(&prefix_stream_tokenizer));
+        }
+    }
+    SetSimdLevel(previous_level);
+    REQUIRE(GetSimdLevel() == GetSupportedSimdLevel());
+}
@@ -1,7 +1,8 @@
 #include <tokenizer.h>
 
 #include <array>
-#include <algorithm>
+#include <charconv>
+#include <cstdint>
 
 #include <error.h>
 
@@ -25,37 +26,218 @@ bool ConstantToken::operator==(const ConstantToken& other) const {
     return value == other.value;
 }
 
+namespace {
+
+enum CharClass : uint8_t {
+    kSpace = 1 << 0,
+    kDigit = 1 << 1,
+    kSymbolStart = 1 << 2,
+    kSymbolInternal = 1 << 3,
+};
+
+constexpr std::array<uint8_t, 256> kCharClasses = [] {
+    std::array<uint8_t, 256> classes{};
+    for (unsigned char chr : std::string_view{" \t\n\v\f\r"}) {
+        classes[chr] |= kSpace;
+    }
+    for (int chr = '0'; chr <= '9'; ++chr) {
+        classes[chr] |= kDigit | kSymbolInternal;
+    }
+    for (int chr = 'a'; chr <= 'z'; ++chr) {
+        classes[chr] |= kSymbolStart | kSymbolInternal;
+        classes[chr - 'a' + 'A'] |= kSymbolStart | kSymbolInternal;
+    }
+    for (unsigned char chr : std::string_view{"<=>*/#"}) {
+        classes[chr] |= kSymbolStart | kSymbolInternal;
+    }
+    classes['+'] |= kSymbolStart;
+    classes['-'] |= kSymbolStart | kSymbolInternal;
+    classes['?'] |= kSymbolInternal;
+    classes['!'] |= kSymbolInternal;
+    return classes;
+}();
+
+bool HasClass(int chr, uint8_t char_class) noexcept {
+    return chr != EOF && (kCharClasses[static_cast<unsigned char>(chr)] & char_class);
+}
+
+bool IsNumber(int target_char, int next_char) noexcept {
+    return ((target_char == '+' || target_char == '-') && HasClass(next_char, kDigit)) ||
+           HasClass(target_char, kDigit);
+}
+
+NumericT ParseNumber(std::string_view digits) {
+    // from_chars doesn't accept the plus sign
+    if (digits.front() == '+') {
+        digits.remove_prefix(1);
+    }
+    NumericT value = 0;
+    auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (error != std::errc{} || end != digits.data() + digits.size()) {
+        throw SyntaxError{"Incorrect number " + std::string{digits}};
+    }
+    return value;
+}
+
+// Sources give characters to Tokenizer::ReadToken, EOF at the end.
+// Atom is the text read since the last StartAtom.
+
+class BufferSource {
+private:
+    std::string_view source_;
+    size_t position_;
+    size_t atom_begin_ = 0;
+    StructuralScanner* scanner_;
+
+public:
+    BufferSource(std::string_view source, size_t position, StructuralScanner* scanner)
+            : source_(source), position_(position), scanner_(scanner) {
+    }
+
+    int Peek() const noexcept {
+        return position_ < source_.size() ? static_cast<unsigned char>(source_[position_]) : EOF;
+    }
+
+    int PeekNext() const noexcept {
+        return position_ + 1 < source_.size() ? static_cast<unsigned char>(source_[position_ + 1])
+                                               : EOF;
+    }
+
+    void Get() noexcept {
+        ++position_;
+    }
+
+    // Moves past the characters of the class, returns the next one.
+    // Spaces are skipped by the scanner, characters are checked only up to the end of the atom.
+    int Skip(uint8_t char_class) {
+        if (char_class == kSpace) {
+            position_ = scanner_->SkipSpaces(position_);
+            return Peek();
+        }
+        size_t atom_end = scanner_->FindStructural(position_);
+        while (position_ < atom_end &&
+               (kCharClasses[static_cast<unsigned char>(source_[position_])] & char_class)) {
+            ++position_;
+        }
+        return Peek();
+    }
+
+    void StartAtom() noexcept {
+        atom_begin_ = position_;
+    }
+
+    std::string_view GetAtom() const noexcept {
+        return source_.substr(atom_begin_, position_ - atom_begin_);
+    }
+
+    size_t GetPosition() const noexcept {
+        return position_;
+    }
+};
+
+class StreamSource {
+private:
+    std::istream* input_stream_;
+    std::string* atom_;
+
+public:
+    // Symbol of the previous token isn't needed anymore
+    StreamSource(std::istream* input_stream, std::string* atom)
+            : input_stream_(input_stream), atom_(atom) {
+        atom_->clear();
+    }
+
+    int Peek() const {
+        return input_stream_->peek();
+    }
+
+    int PeekNext() const {
+        input_stream_->get();
+        int next_char = input_stream_->peek();
+        input_stream_->unget();
+        return next_char;
+    }
+
+    void Get() {
+        atom_->push_back(static_cast<char>(input_stream_->get()));
+    }
+
+    // Moves past the characters of the class, returns the next one.
+    // Only the characters of the atom are kept.
+    int Skip(uint8_t char_class) {
+        int current_char = input_stream_->peek();
+        while (HasClass(current_char, char_class)) {
+            if (char_class == kSpace) {
+                input_stream_->get();
+            } else {
+                Get();
+            }
+            current_char = input_stream_->peek();
+        }
+        return current_char;
+    }
+
+    void StartAtom() noexcept {
+        atom_->clear();
+    }
+
+    std::string_view GetAtom() const noexcept {
+        return *atom_;
+    }
+};
+
+}  // namespace
+
 Tokenizer::Tokenizer(std::istream* in) : input_stream_(in) {
     Next();
 }
 
+Tokenizer::Tokenizer(std::string_view source) : source_(source), scanner_(source) {
+    Next();
+}
+
 bool Tokenizer::IsEnd() const noexcept {
     return end_flag_;  // == EOF (\0)
 }
 
 void Tokenizer::Next() {
-    int current_char = SkipSpaces();
+    if (input_stream_) {
+        StreamSource source{input_stream_, &symbol_buffer_};
+        ReadToken(&source);
+    } else {
+        BufferSource source{source_, position_, &scanner_};
+        ReadToken(&source);
+        position_ = source.GetPosition();
+    }
+}
+
+const Token& Tokenizer::GetToken() const noexcept {
+    return last_read_token_;
+}
+
+template <class Source>
+void Tokenizer::ReadToken(Source* source) {
+    int current_char = source->Skip(kSpace);
     // Skip if it EOF
-    if (IsEndSymbol(current_char)) {
+    if (current_char == EOF) {
         end_flag_ = true;
         return;
     }
     // Processing one symbol tokens
     if (current_char == '(') {
         last_read_token_.emplace<BracketToken>(BracketToken::OPEN);
-        input_stream_->get();
+        source->Get();
     } else if (current_char == ')') {
         last_read_token_.emplace<BracketToken>(BracketToken::CLOSE);
-        input_stream_->get();
+        source->Get();
     } else if (current_char == '\'') {
         last_read_token_.emplace<QuoteToken>();
-        input_stream_->get();
+        source->Get();
     } else if (current_char == '.') {
         last_read_token_.emplace<DotToken>();
-        input_stream_->get();
+        source->Get();
     } else if (current_char == '#') {
-        input_stream_->get();
-        current_char = input_stream_->peek();
+        current_char = source->PeekNext();
         if (current_char == 't') {
             last_read_token_.emplace<BooleanToken>(true);
         } else if (current_char == 'f') {
@@ -63,76 +245,20 @@ void Tokenizer::Next() {
         } else {
             throw SyntaxError("Incorrectness! #");  // todo: Add more informational text of error
         }
-        input_stream_->get();
+        source->Get();
+        source->Get();
         // Processing more symbols tokens:
-    } else if (IsNumber(current_char, GetNextChar())) {
-        if (current_char == '+') {
-            current_char = input_stream_->peek();
-        }
-        std::string current_number;  // todo: SSO?
-        do {
-            current_number += current_char;
-            input_stream_->get();
-            current_char = input_stream_->peek();
-        } while (std::isdigit(current_char));
-        last_read_token_.emplace<ConstantToken>(std::stoll(current_number));
-    } else if (IsSymbolsStart(current_char)) {
-        std::string symbols;
-        do {
-            symbols += input_stream_->get();
-        } while (IsSymbolsInternal(input_stream_->peek()));
-        last_read_token_.emplace<SymbolToken>(symbols);
+    } else if (IsNumber(current_char, source->PeekNext())) {
+        source->StartAtom();
+        source->Get();
+        source->Skip(kDigit);
+        last_read_token_.emplace<ConstantToken>(ParseNumber(source->GetAtom()));
+    } else if (HasClass(current_char, kSymbolStart)) {
+        source->StartAtom();
+        source->Get();
+        source->Skip(kSymbolInternal);
+        last_read_token_.emplace<SymbolToken>(source->GetAtom());
     } else {
         throw SyntaxError("Unknown name!");
     }
 }
-
-Token Tokenizer::GetToken() const noexcept {
-    return last_read_token_;
-}
-
-[[maybe_unused]] bool Tokenizer::IsBinaryOperation(int target_char, int next_char) noexcept {
-    static constexpr std::array<char, 7> kOperationsChars{'+', '-', '*', '/', '<', '=', '>'};
-    return (std::find(kOperationsChars.begin(), kOperationsChars.end(), target_char) !=
-            kOperationsChars.end()) &&
-           !isdigit(next_char);
-}
-
-bool Tokenizer::IsNumber(int target_char, int next_char) noexcept {
-    return ((target_char == '+' || target_char == '-') && std::isdigit(next_char)) ||
-           std::isdigit(target_char);
-}
-
-bool Tokenizer::IsSymbolsInternal(int target_char) noexcept {
-    static constexpr std::array<int, 10> kAvailableChars{'<', '=', '>', '*', '/',
-                                                         '#', '?', '!', '-'};
-    return std::isalpha(target_char) || std::isdigit(target_char) ||
-           std::find(kAvailableChars.begin(), kAvailableChars.end(), target_char) !=
-           kAvailableChars.end();
-}
-
-bool Tokenizer::IsSymbolsStart(int target_char) noexcept {
-    static constexpr std::array<int, 8> kAvailableChars{'<', '=', '>', '*', '/', '#', '+', '-'};
-    return std::isalpha(target_char) || std::find(kAvailableChars.begin(), kAvailableChars.end(),
-                                                  target_char) != kAvailableChars.end();
-}
-
-bool Tokenizer::IsEndSymbol(int target_char) noexcept {
-    return target_char == EOF;
-}
-
-int Tokenizer::GetNextChar() const noexcept {
-    input_stream_->get();
-    int next_char = input_stream_->peek();
-    input_stream_->unget();
-    return next_char;
-}
-
-int Tokenizer::SkipSpaces() noexcept {
-    int current_char = input_stream_->peek();
-    while (std::isspace(current_char)) {
-        input_stream_->get();
-        current_char = input_stream_->peek();
-    }
-    return current_char;
-}
@@ -3,17 +3,17 @@
 #include <variant>
 #include <optional>
 #include <istream>
-#include "string"
+#include <string>
+#include <string_view>
 
 #include "constans.h"
+#include "scanner.h"
 
+// Name refers to the source of the tokenizer and is valid until the next token is read
 struct SymbolToken {
-    std::string name;
+    std::string_view name;
 
-    SymbolToken(std::string str) noexcept : name(std::move(str)) {
-    }
-
-    SymbolToken(char chr) noexcept : name(std::string{chr}) {
+    SymbolToken(std::string_view str) noexcept : name(str) {
     }
 
     bool operator==(const SymbolToken& other) const;
@@ -50,9 +50,16 @@ struct ConstantToken {
 using Token = std::variant<std::monostate, ConstantToken, BracketToken, SymbolToken, BooleanToken,
         QuoteToken, DotToken>;
 
+// Reads tokens either from a stream, character by character, or from a contiguous buffer.
+// Tokens of the buffer refer to it without copying, so it must outlive them.
 class Tokenizer {
 private:
-    std::istream* input_stream_;
+    std::istream* input_stream_ = nullptr;
+    std::string_view source_;
+    size_t position_ = 0;
+    StructuralScanner scanner_;
+    // Name of the last symbol read from the stream
+    std::string symbol_buffer_;
     Token last_read_token_;
     bool end_flag_ = false;
 
@@ -60,6 +67,9 @@ public:
     // Creates a tokenizer that reads characters from the in stream.
     Tokenizer(std::istream* in);
 
+    // Creates a tokenizer over the whole source.
+    explicit Tokenizer(std::string_view source);
+
     // Whether we have reached the end of the stream or not.
     bool IsEnd() const noexcept;
 
@@ -68,20 +78,9 @@ public:
     void Next();
 
     // Get the current token.
-    Token GetToken() const noexcept;
+    const Token& GetToken() const noexcept;
 
 private:
-    [[maybe_unused]] static bool IsBinaryOperation(int target_char, int next_char) noexcept;
-
-    static bool IsNumber(int target_char, int next_char) noexcept;
-
-    static bool IsSymbolsInternal(int target_char) noexcept;
-
-    static bool IsSymbolsStart(int target_char) noexcept;
-
-    static bool IsEndSymbol(int target_char) noexcept;
-
-    int SkipSpaces() noexcept;
-
-    int GetNextChar() const noexcept;
+    template <class Source>
+    void ReadToken(Source* source);
 };